@@ -16,17 +16,43 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    line_chart/chartframeclock.cpp \
+    line_chart/chartrecorder.cpp \
+    line_chart/chartseriesmodel.cpp \
+    line_chart/chartsoak.cpp \
+    line_chart/charttrace.cpp \
+    line_chart/chunkstore.cpp \
+    line_chart/derivedseries.cpp \
     line_chart/linechart.cpp \
+    line_chart/rangeindex.cpp \
+    line_chart/rasterline.cpp \
+    line_chart/serieshistory.cpp \
+    line_chart/seriesrollup.cpp \
     main.cpp \
     mainwindow.cpp
 
 HEADERS += \
+    line_chart/chartframeclock.h \
+    line_chart/chartrecorder.h \
+    line_chart/chartseriesmodel.h \
+    line_chart/chartsoak.h \
+    line_chart/charttrace.h \
+    line_chart/chunkstore.h \
+    line_chart/derivedseries.h \
     line_chart/linechart.h \
+    line_chart/pointsearch.h \
+    line_chart/rangeindex.h \
+    line_chart/rasterline.h \
+    line_chart/serieshistory.h \
+    line_chart/seriesrollup.h \
     mainwindow.h
 
 INCLUDEPATH += \
     line_chart/
 
+# ChartSoak 读取进程的常驻内存
+win32: LIBS += -lpsapi
+
 FORMS += \
     mainwindow.ui
 
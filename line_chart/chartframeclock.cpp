@@ -0,0 +1,188 @@
+#include "chartframeclock.h"
+#include "linechart.h"
+#include <QAnimationDriver>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QPointer>
+
+namespace
+{
+/// 属性动画的时钟：不自己计时，由帧时钟每帧推进一次，与数据和重绘在同一轮中
+class FrameDriver : public QAnimationDriver
+{
+public:
+    FrameDriver(ChartFrameClock* clock) : QAnimationDriver(clock), clock(clock)
+    {
+    }
+
+protected:
+    void start() override
+    {
+        QAnimationDriver::start();
+        clock->requestFrame();
+    }
+
+private:
+    ChartFrameClock* clock;
+};
+}
+
+/// 随 QApplication 一起销毁
+ChartFrameClock *ChartFrameClock::instance()
+{
+    static QPointer<ChartFrameClock> clock;
+    if (!clock)
+        clock = new ChartFrameClock(QCoreApplication::instance());
+    return clock;
+}
+
+ChartFrameClock::ChartFrameClock(QObject *parent) : QObject(parent)
+{
+    timer.setInterval(16);
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &ChartFrameClock::tick);
+    driver = new FrameDriver(this);
+}
+
+ChartFrameClock::~ChartFrameClock()
+{
+    if (installed)
+        driver->uninstall();
+}
+
+void ChartFrameClock::registerChart(LineChart *chart)
+{
+    if (charts.contains(chart))
+        return ;
+    charts.append(chart);
+    updateDriver();
+    requestFrame();
+}
+
+void ChartFrameClock::unregisterChart(LineChart *chart)
+{
+    int index = charts.indexOf(chart);
+    if (index < 0)
+        return ;
+    charts.removeAt(index);
+    if (nextChart > index)
+        nextChart--;
+    if (nextChart >= charts.size())
+        nextChart = 0;
+    if (charts.isEmpty())
+        timer.stop();
+    updateDriver();
+}
+
+/// 有数据、动画或重绘需要处理，确保时钟在走
+void ChartFrameClock::requestFrame()
+{
+    if (!timer.isActive())
+        timer.start();
+}
+
+void ChartFrameClock::setFrameInterval(int ms)
+{
+    timer.setInterval(qMax(ms, 1));
+}
+
+int ChartFrameClock::getFrameInterval() const
+{
+    return timer.interval();
+}
+
+/// 每帧所有折线图重绘的预计耗时上限；每帧至少提交一个，避免永远推迟
+void ChartFrameClock::setFrameBudget(double ms)
+{
+    frameBudget = qMax(ms, 0.0);
+}
+
+double ChartFrameClock::getFrameBudget() const
+{
+    return frameBudget;
+}
+
+/// 由帧时钟推进属性动画，与数据和重绘在同一帧中，默认关闭
+/// 注意 QAnimationDriver 是整个程序共用的：开启后（有折线图注册时）程序中所有的属性动画都只在帧时钟走时推进，
+/// 帧间隔也随之改变；不需要对齐时保持关闭，动画使用Qt默认的时钟
+void ChartFrameClock::setDriveAnimations(bool drive)
+{
+    driveAnimations = drive;
+    updateDriver();
+}
+
+bool ChartFrameClock::isDrivingAnimations() const
+{
+    return driveAnimations;
+}
+
+const FrameClockStatistics &ChartFrameClock::getStatistics() const
+{
+    return statistics;
+}
+
+void ChartFrameClock::tick()
+{
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    statistics.frames++;
+
+    // 数据：各折线图排队的点一次性加入模型
+    for (int i = 0; i < charts.size(); i++)
+        charts.at(i)->drainQueuedPoints();
+
+    // 动画：接管了动画时钟时，所有属性动画推进到同一时刻，设置的显示范围只是登记重绘
+    const bool animating = installed && driver->isRunning();
+    if (animating)
+        driver->advance();
+
+    // 绘制：从上一帧第一个被推迟的开始，在预算内提交重绘（之后由Qt合并为一次绘制）
+    double budget = frameBudget - frameTimer.nsecsElapsed() / 1e6;
+    bool presented = false, pending = false;
+    int firstDeferred = -1;
+    const int n = charts.size();
+    for (int k = 0; k < n; k++)
+    {
+        const int i = (nextChart + k) % n;
+        LineChart* chart = charts.at(i);
+        if (!chart->framePending)
+            continue;
+        if (!chart->isOnScreen())
+        {
+            chart->skipFrame();
+            statistics.skipped++;
+            continue;
+        }
+        const double cost = chart->pendingFrameCost();
+        if (presented && cost > budget)
+        {
+            if (firstDeferred < 0)
+                firstDeferred = i;
+            statistics.deferred++;
+            pending = true;
+            continue;
+        }
+        budget -= cost;
+        chart->presentFrame();
+        statistics.presented++;
+        presented = true;
+    }
+    nextChart = qMax(firstDeferred, 0);
+    statistics.lastFrameTime = frameTimer.nsecsElapsed() / 1e6;
+
+    if (!pending && !animating)
+        timer.stop();
+}
+
+/// 开启 driveAnimations 且有折线图注册时接管属性动画的时钟，否则交还给Qt默认的时钟
+void ChartFrameClock::updateDriver()
+{
+    const bool install = driveAnimations && !charts.isEmpty();
+    if (install == installed)
+        return ;
+    if (install)
+        driver->install();
+    else
+        driver->uninstall();
+    installed = install;
+}
@@ -0,0 +1,63 @@
+#ifndef CHARTFRAMECLOCK_H
+#define CHARTFRAMECLOCK_H
+
+#include <QObject>
+#include <QList>
+#include <QTimer>
+
+class LineChart;
+class QAnimationDriver;
+
+/// 帧时钟的统计
+struct FrameClockStatistics
+{
+    qint64 frames = 0;                      // 时钟走过的帧数
+    qint64 presented = 0;                   // 提交重绘的次数
+    qint64 deferred = 0;                    // 超出预算推迟到下一帧的次数
+    qint64 skipped = 0;                     // 不可见而跳过的次数
+    double lastFrameTime = 0;               // 上一帧时钟自身的耗时(ms)，不含之后的绘制
+};
+
+/**
+ * 进程内所有折线图共用的帧时钟（比如一个页面上几十个折线图）
+ * 每帧一次性：取出各折线图排队的数据、（可选）推进所有属性动画、在预算内提交重绘
+ * 不可见或被完全遮挡的折线图直接跳过（动画跳到终点），重新显示时由Qt重绘
+ * 预计耗时超出本帧剩余预算的重绘推迟到下一帧，并在下一帧优先处理
+ * 空闲（没有动画、没有待绘制的折线图）时时钟停止
+ */
+class ChartFrameClock : public QObject
+{
+    Q_OBJECT
+public:
+    static ChartFrameClock* instance();
+    ~ChartFrameClock() override;
+
+    void registerChart(LineChart* chart);
+    void unregisterChart(LineChart* chart);
+    void requestFrame();
+
+    void setFrameInterval(int ms);
+    int getFrameInterval() const;
+    void setFrameBudget(double ms);
+    double getFrameBudget() const;
+    void setDriveAnimations(bool drive);
+    bool isDrivingAnimations() const;
+    const FrameClockStatistics& getStatistics() const;
+
+private:
+    ChartFrameClock(QObject* parent);
+    void tick();
+    void updateDriver();
+
+private:
+    QList<LineChart*> charts;               // 注册的折线图
+    QTimer timer;
+    QAnimationDriver* driver = nullptr;     // 替代Qt默认的动画时钟，每帧由 tick 推进
+    bool driveAnimations = false;           // 是否安装 driver（影响程序中所有的属性动画）
+    bool installed = false;                 // driver 已安装
+    int nextChart = 0;                      // 本帧第一个处理的折线图（上一帧第一个被推迟的）
+    double frameBudget = 8;                 // 每帧所有重绘的预计耗时上限(ms)
+    FrameClockStatistics statistics;
+};
+
+#endif // CHARTFRAMECLOCK_H
@@ -0,0 +1,594 @@
+#include "chartrecorder.h"
+#include <QAnimationDriver>
+#include <QCoreApplication>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QResizeEvent>
+#include <QPropertyAnimation>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+const char* const RecordHeader = "LineChartRecord 1";
+
+/// 模拟时钟：只在回放时手动推进，属性动画的进度与实际运行速度无关
+class ReplayClock : public QAnimationDriver
+{
+public:
+    void advanceTo(qint64 ms)
+    {
+        now = ms;
+        advanceAnimation();
+    }
+
+    qint64 elapsed() const override
+    {
+        return now - startTime;
+    }
+
+    void advance() override
+    {
+    }
+
+protected:
+    void start() override
+    {
+        startTime = now;
+        QAnimationDriver::start();
+    }
+
+private:
+    qint64 now = 0;
+    qint64 startTime = 0;
+};
+
+/// 折线的描述：普通折线为 "line 颜色 标题"，派生折线为 "derive 源 类型 窗口 按X跨度 颜色 标题"
+QString lineText(const ChartData& data)
+{
+    const QString color = data.color.name(QColor::HexArgb);
+    if (data.derivedSource >= 0)
+        return QString("derive %1 %2 %3 %4 %5 %6").arg(data.derivedSource).arg(int(data.derived.getType()))
+                .arg(data.derived.getWindow()).arg(int(data.derived.isSpanX())).arg(color).arg(data.title);
+    return QString("line %1 %2").arg(color).arg(data.title);
+}
+
+/// "adds 折线 数量 x y x y ..."
+QString pointsText(int index, const QList<QPoint>& points)
+{
+    QStringList fields;
+    fields << "adds" << QString::number(index) << QString::number(points.size());
+    for (const QPoint& p: points)
+        fields << QString::number(p.x()) << QString::number(p.y());
+    return fields.join(' ');
+}
+
+/// "原始点跨度 级数 桶宽 跨度 桶宽 跨度 ..."
+QString retentionText(const RetentionPolicy& policy)
+{
+    QStringList fields;
+    fields << QString::number(policy.rawHorizon) << QString::number(policy.tiers.size());
+    for (const RollupTier& tier: policy.tiers)
+        fields << QString::number(tier.bucket) << QString::number(tier.horizon);
+    return fields.join(' ');
+}
+
+/// 从 fields 的第 first 项开始读取 retentionText 的内容
+RetentionPolicy parseRetention(const QStringList& fields, int first)
+{
+    RetentionPolicy policy;
+    policy.rawHorizon = fields.value(first).toInt();
+    const int count = fields.value(first + 1).toInt();
+    for (int i = 0; i < count; i++)
+    {
+        RollupTier tier;
+        tier.bucket = fields.value(first + 2 + i * 2).toInt();
+        tier.horizon = fields.value(first + 3 + i * 2).toInt();
+        policy.tiers.append(tier);
+    }
+    return policy;
+}
+
+/// 鼠标事件的位置（Qt 6 起 pos() 已废弃）
+QPoint eventPos(const QMouseEvent* e)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return e->position().toPoint();
+#else
+    return e->pos();
+#endif
+}
+
+/// 滚轮事件的位置（Qt 5.14 起 pos() 已废弃）
+QPoint eventPos(const QWheelEvent* e)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    return e->position().toPoint();
+#else
+    return e->pos();
+#endif
+}
+
+/// 按空格分割，忽略连续的空格
+QStringList splitFields(const QString& line)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    return line.split(' ', Qt::SkipEmptyParts);
+#else
+    return line.split(' ', QString::SkipEmptyParts);
+#endif
+}
+
+/// 排序后的第 p 百分位（最近秩）
+double percentile(const QList<double>& sorted, double p)
+{
+    if (sorted.isEmpty())
+        return 0;
+    int rank = qBound(0, qCeil(p / 100 * sorted.size()) - 1, sorted.size() - 1);
+    return sorted.at(rank);
+}
+}
+
+ChartRecorder::ChartRecorder(LineChart *chart, QObject *parent) : QObject(parent), chart(chart)
+{
+}
+
+ChartRecorder::~ChartRecorder()
+{
+    stop();
+}
+
+/// 开始记录到文件，先写入当前的大小、数据与配置
+/// 派生折线只记录派生关系，汇总的桶按其中的点记录
+bool ChartRecorder::start(const QString &path)
+{
+    stop();
+    if (!chart)
+        return false;
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        qWarning() << "无法写入记录文件：" << path;
+        return false;
+    }
+    stream.setDevice(&file);
+    stream.setCodec("UTF-8");
+
+    ChartSeriesModel* model = chart->getModel();
+    stream << RecordHeader << "\n";
+    stream << "size " << chart->width() << " " << chart->height() << "\n";
+    for (int i = 0; i < model->lineCount(); i++)
+        stream << lineText(model->line(i)) << "\n";
+    for (int i = 0; i < model->lineCount(); i++)
+    {
+        if (model->line(i).derivedSource >= 0)
+            continue;
+        QList<QPoint> points;
+        model->collectPoints(i, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 0, points);
+        for (const QPoint& p: points)
+            stream << "point " << i << " " << p.x() << " " << p.y() << "\n";
+    }
+    for (int i = 0; i < model->getXLabels().size(); i++)
+        stream << "label " << model->getXLabelPoss().at(i) << " " << model->getXLabels().at(i) << "\n";
+    for (int i = 0; i < model->lineCount(); i++)
+    {
+        const ChartData& data = model->line(i);
+        if (data.reorderWindow > 0)
+            stream << "reorder " << i << " " << data.reorderWindow << "\n";
+        if (data.rollup.isEnabled())
+            stream << "retention " << i << " " << retentionText(data.rollup.getPolicy()) << "\n";
+    }
+    stream << "events\n";
+
+    clock.start();
+    chart->installEventFilter(this);
+    connect(model, &ChartSeriesModel::pointIngested, this, [=](int index, int x, int y) {
+        writeEvent(QString("add %1 %2 %3").arg(index).arg(x).arg(y));
+    });
+    connect(model, &ChartSeriesModel::pointsIngested, this, [=](int index, const QList<QPoint>& points) {
+        writeEvent(pointsText(index, points));
+    });
+    connect(model, &ChartSeriesModel::xLabelIngested, this, [=](int x, const QString& label) {
+        writeEvent(QString("label %1 %2").arg(x).arg(label));
+    });
+    connect(model, &ChartSeriesModel::firstRemoved, this, [=](int index) {
+        writeEvent(QString("evict %1 1").arg(index));
+    });
+    connect(model, &ChartSeriesModel::reorderWindowChanged, this, [=](int index, int window) {
+        writeEvent(QString("reorder %1 %2").arg(index).arg(window));
+    });
+    connect(model, &ChartSeriesModel::reorderFlushed, this, [=](int index) {
+        writeEvent(QString("flush %1").arg(index));
+    });
+    connect(model, &ChartSeriesModel::retentionChanged, this, [=](int index) {
+        writeEvent(QString("retention %1 %2").arg(index).arg(retentionText(model->line(index).rollup.getPolicy())));
+    });
+    connect(model, &ChartSeriesModel::lineAdded, this, &ChartRecorder::onLineAdded);
+    connect(model, &ChartSeriesModel::lineRemoved, this, [=](int index) {
+        writeEvent(QString("remove %1").arg(index));
+    });
+    connect(model, &ChartSeriesModel::pointsAppended, this, &ChartRecorder::onPointsAppended);
+    return true;
+}
+
+void ChartRecorder::stop()
+{
+    if (!file.isOpen())
+        return ;
+    if (chart)
+    {
+        chart->removeEventFilter(this);
+        disconnect(chart->getModel(), nullptr, this, nullptr);
+    }
+    stream.flush();
+    stream.setDevice(nullptr);
+    file.close();
+}
+
+bool ChartRecorder::isRecording() const
+{
+    return file.isOpen();
+}
+
+bool ChartRecorder::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched != chart)
+        return QObject::eventFilter(watched, event);
+
+    switch (event->type())
+    {
+    case QEvent::MouseMove:
+    {
+        auto e = static_cast<QMouseEvent*>(event);
+        writeEvent(QString("move %1 %2 %3 %4").arg(eventPos(e).x()).arg(eventPos(e).y())
+                   .arg(int(e->buttons())).arg(int(e->modifiers())));
+        break;
+    }
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    {
+        auto e = static_cast<QMouseEvent*>(event);
+        writeEvent(QString("%1 %2 %3 %4 %5 %6").arg(event->type() == QEvent::MouseButtonPress ? "press" : "release")
+                   .arg(eventPos(e).x()).arg(eventPos(e).y())
+                   .arg(int(e->button())).arg(int(e->buttons())).arg(int(e->modifiers())));
+        break;
+    }
+    case QEvent::Wheel:
+    {
+        auto e = static_cast<QWheelEvent*>(event);
+        writeEvent(QString("wheel %1 %2 %3 %4 %5 %6").arg(eventPos(e).x()).arg(eventPos(e).y())
+                   .arg(e->angleDelta().x()).arg(e->angleDelta().y())
+                   .arg(int(e->buttons())).arg(int(e->modifiers())));
+        break;
+    }
+    case QEvent::Enter:
+        writeEvent("enter");
+        break;
+    case QEvent::Leave:
+        writeEvent("leave");
+        break;
+    case QEvent::Resize:
+    {
+        auto e = static_cast<QResizeEvent*>(event);
+        writeEvent(QString("resize %1 %2").arg(e->size().width()).arg(e->size().height()));
+        break;
+    }
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+/// 新的折线：派生折线只记录派生关系，其他的连同已有的点与X轴label一起记录
+void ChartRecorder::onLineAdded(int index)
+{
+    ChartSeriesModel* model = chart->getModel();
+    const ChartData& data = model->line(index);
+    writeEvent(lineText(data));
+    if (data.derivedSource >= 0)
+        return ;
+    for (int i = 0; i < data.xLabels.size(); i++) // 与点一一对应，回放时同样合并到已有的label中
+    {
+        const int x = data.external.isValid() ? data.external.xs[i] : data.points.at(i).x();
+        writeEvent(QString("label %1 %2").arg(x).arg(data.xLabels.at(i)));
+    }
+    QList<QPoint> points;
+    model->collectPoints(index, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 0, points);
+    if (!points.isEmpty())
+        writeEvent(pointsText(index, points));
+}
+
+/// 调用者数组的折线不经过 addPoint，在追加后记录
+void ChartRecorder::onPointsAppended(int index, int first, int count)
+{
+    ChartSeriesModel* model = chart->getModel();
+    if (!model->line(index).external.isValid())
+        return ;
+    for (int i = first; i < first + count && i < model->hotCount(index); i++)
+    {
+        const QPoint p = model->hotPoint(index, i);
+        writeEvent(QString("add %1 %2 %3").arg(index).arg(p.x()).arg(p.y()));
+    }
+}
+
+void ChartRecorder::writeEvent(const QString &text)
+{
+    stream << clock.elapsed() << " " << text << "\n";
+}
+
+
+QString ReplayReport::toString() const
+{
+    return QString("events %1, frames %2, duration %3 ms, paint p50 %4 ms, p90 %5 ms, p99 %6 ms, max %7 ms, "
+                   "animations %8, interacting frames %9")
+            .arg(events).arg(frames).arg(duration)
+            .arg(paintP50, 0, 'f', 3).arg(paintP90, 0, 'f', 3).arg(paintP99, 0, 'f', 3).arg(paintMax, 0, 'f', 3)
+            .arg(animations).arg(interactingFrames);
+}
+
+ChartReplayer::ChartReplayer(LineChart *chart, QObject *parent) : QObject(parent), chart(chart)
+{
+}
+
+/// 回放记录文件，每 frameInterval 毫秒（模拟时间）为一帧
+/// 回放完后继续运行到动画全部结束，结果通过 getReport() 获取
+bool ChartReplayer::replay(const QString &path, int frameInterval)
+{
+    QFile file(path);
+    if (!chart || !file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qWarning() << "无法读取记录文件：" << path;
+        return false;
+    }
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+    if (!readSnapshot(in))
+    {
+        qWarning() << "记录文件格式错误：" << path;
+        return false;
+    }
+
+    report = ReplayReport();
+    paintTimes.clear();
+    newChildren.clear();
+    chart->installEventFilter(this);
+    chart->show();
+    ReplayClock clock;
+    clock.install();
+
+    qint64 now = 0;
+    auto frame = [&](qint64 time) {
+        clock.advanceTo(time);
+        runFrame();
+    };
+    frame(now);
+    while (!in.atEnd())
+    {
+        QStringList fields = splitFields(in.readLine());
+        if (fields.size() < 2)
+            continue;
+        qint64 time = fields.at(0).toLongLong();
+        while (now + frameInterval <= time)
+        {
+            now += frameInterval;
+            frame(now);
+        }
+        replayEvent(fields);
+        countAnimations();
+        report.events++;
+    }
+
+    // 等待剩下的动画结束（最多5秒）
+    for (qint64 end = now + 5000; now < end && chart->isInteracting(); )
+    {
+        now += frameInterval;
+        frame(now);
+    }
+    now += frameInterval;
+    frame(now);
+
+    clock.uninstall();
+    chart->removeEventFilter(this);
+
+    std::sort(paintTimes.begin(), paintTimes.end());
+    report.frames = paintTimes.size();
+    report.duration = now;
+    report.paintP50 = percentile(paintTimes, 50);
+    report.paintP90 = percentile(paintTimes, 90);
+    report.paintP99 = percentile(paintTimes, 99);
+    report.paintMax = paintTimes.isEmpty() ? 0 : paintTimes.last();
+    return true;
+}
+
+const ReplayReport &ChartReplayer::getReport() const
+{
+    return report;
+}
+
+/// 统计每一帧的绘制耗时，以及新启动的动画
+bool ChartReplayer::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched != chart)
+        return QObject::eventFilter(watched, event);
+
+    if (event->type() == QEvent::ChildAdded)
+    {
+        newChildren.append(static_cast<QChildEvent*>(event)->child());
+    }
+    else if (event->type() == QEvent::Paint && !painting)
+    {
+        // 自己转发一次，以得到完整的绘制耗时
+        painting = true;
+        QElapsedTimer timer;
+        timer.start();
+        QCoreApplication::sendEvent(chart, event);
+        paintTimes.append(timer.nsecsElapsed() / 1e6);
+        if (chart->isInteracting())
+            report.interactingFrames++;
+        painting = false;
+        return true;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+/// 读取开头的大小与数据快照，按顺序加入折线，再设置标签、重排窗口与保留策略
+bool ChartReplayer::readSnapshot(QTextStream &in)
+{
+    if (in.readLine() != RecordHeader)
+        return false;
+    QList<QStringList> lines;
+    QStringList titles;
+    QList<QList<QPoint>> points;
+    QList<QStringList> configs;             // 与事件的格式相同，加入折线后回放
+    while (!in.atEnd())
+    {
+        QString line = in.readLine();
+        QStringList fields = line.split(' ');
+        const QString& type = fields.at(0);
+        if (type == "events")
+        {
+            for (int i = 0; i < lines.size(); i++)
+                addRecordedLine(lines.at(i), titles.at(i), points.at(i));
+            for (const QStringList& config: configs)
+                replayEvent(QStringList("0") + config);
+            return true;
+        }
+        else if (type == "size" && fields.size() >= 3)
+        {
+            chart->resize(fields.at(1).toInt(), fields.at(2).toInt());
+        }
+        else if ((type == "line" && fields.size() >= 2) || (type == "derive" && fields.size() >= 6))
+        {
+            lines.append(fields);
+            titles.append(line.section(' ', type == "line" ? 2 : 6));
+            points.append(QList<QPoint>());
+        }
+        else if (type == "point" && fields.size() >= 4)
+        {
+            int index = fields.at(1).toInt();
+            if (index < 0 || index >= points.size())
+                return false;
+            points[index].append(QPoint(fields.at(2).toInt(), fields.at(3).toInt()));
+        }
+        else if (type == "label" || type == "reorder" || type == "retention")
+        {
+            configs.append(fields);
+        }
+    }
+    return false;
+}
+
+/// 加入记录中的一条折线，fields 为 lineText 的各项（不含时间戳）
+void ChartReplayer::addRecordedLine(const QStringList &fields, const QString &title, const QList<QPoint> &points)
+{
+    if (fields.at(0) == "derive")
+    {
+        chart->getModel()->addDerivedLine(fields.at(1).toInt(), DerivedSeries::Type(fields.at(2).toInt()),
+                                          fields.at(3).toInt(), fields.at(4).toInt(), QColor(fields.at(5)), title);
+        return ;
+    }
+    ChartData data;
+    data.color = QColor(fields.at(1));
+    data.title = title;
+    data.points = points;
+    chart->addLine(data);
+}
+
+void ChartReplayer::replayEvent(const QStringList &fields)
+{
+    const QString& type = fields.at(1);
+    auto arg = [&](int i) {
+        return i + 2 < fields.size() ? fields.at(i + 2).toInt() : 0;
+    };
+
+    if (type == "move")
+    {
+        QMouseEvent e(QEvent::MouseMove, QPointF(arg(0), arg(1)), Qt::NoButton,
+                      Qt::MouseButtons(arg(2)), Qt::KeyboardModifiers(arg(3)));
+        QCoreApplication::sendEvent(chart, &e);
+    }
+    else if (type == "press" || type == "release")
+    {
+        QMouseEvent e(type == "press" ? QEvent::MouseButtonPress : QEvent::MouseButtonRelease,
+                      QPointF(arg(0), arg(1)), Qt::MouseButton(arg(2)),
+                      Qt::MouseButtons(arg(3)), Qt::KeyboardModifiers(arg(4)));
+        QCoreApplication::sendEvent(chart, &e);
+    }
+    else if (type == "wheel")
+    {
+        QPoint pos(arg(0), arg(1));
+        QWheelEvent e(pos, chart->mapToGlobal(pos), QPoint(), QPoint(arg(2), arg(3)),
+                      Qt::MouseButtons(arg(4)), Qt::KeyboardModifiers(arg(5)), Qt::NoScrollPhase, false);
+        QCoreApplication::sendEvent(chart, &e);
+    }
+    else if (type == "enter" || type == "leave")
+    {
+        QEvent e(type == "enter" ? QEvent::Enter : QEvent::Leave);
+        QCoreApplication::sendEvent(chart, &e);
+    }
+    else if (type == "resize")
+    {
+        chart->resize(arg(0), arg(1));
+    }
+    else if (type == "add")
+    {
+        chart->getModel()->addPoint(arg(0), arg(1), arg(2));
+    }
+    else if (type == "adds")
+    {
+        QList<QPoint> points;
+        for (int i = 0; i < arg(1); i++)
+            points.append(QPoint(arg(2 + i * 2), arg(3 + i * 2)));
+        chart->getModel()->addPoints(arg(0), points);
+    }
+    else if (type == "label")
+    {
+        chart->getModel()->insertXLabel(arg(0), fields.mid(3).join(' '));
+    }
+    else if (type == "evict")
+    {
+        for (int i = 0; i < arg(1); i++)
+            chart->getModel()->removeFirst(arg(0));
+    }
+    else if (type == "reorder")
+    {
+        chart->getModel()->setReorderWindow(arg(0), arg(1));
+    }
+    else if (type == "flush")
+    {
+        chart->getModel()->flushReorder(arg(0));
+    }
+    else if (type == "retention")
+    {
+        chart->getModel()->setRetention(arg(0), parseRetention(fields, 3));
+    }
+    else if (type == "line" && fields.size() >= 3)
+    {
+        addRecordedLine(fields.mid(1), fields.mid(3).join(' '), QList<QPoint>());
+    }
+    else if (type == "derive" && fields.size() >= 7)
+    {
+        addRecordedLine(fields.mid(1), fields.mid(7).join(' '), QList<QPoint>());
+    }
+    else if (type == "remove")
+    {
+        chart->removeLine(arg(0));
+    }
+}
+
+/// 推进模拟时钟后处理一轮事件（包括绘制）
+void ChartReplayer::runFrame()
+{
+    QCoreApplication::processEvents();
+    countAnimations();
+}
+
+/// 子对象添加时还没有构造完成，之后再判断类型
+void ChartReplayer::countAnimations()
+{
+    for (const QPointer<QObject>& child: newChildren)
+        if (qobject_cast<QPropertyAnimation*>(child.data()))
+            report.animations++;
+    newChildren.clear();
+}
@@ -0,0 +1,87 @@
+#ifndef CHARTRECORDER_H
+#define CHARTRECORDER_H
+
+#include <QObject>
+#include <QFile>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QPointer>
+#include "linechart.h"
+
+/**
+ * 记录折线图收到的鼠标、滚轮事件与调用者对模型的操作，保存为文本文件
+ * 文件开头是折线图大小与已有数据（折线、派生关系、标签、重排与保留策略）的快照，之后每行一个事件，以毫秒时间戳开头
+ * 数据在模型的接口处记录（原始的点、标签、乱序插入与配置），派生、汇总等由回放时的模型重新计算
+ */
+class ChartRecorder : public QObject
+{
+    Q_OBJECT
+public:
+    ChartRecorder(LineChart* chart, QObject* parent = nullptr);
+    ~ChartRecorder() override;
+
+    bool start(const QString& path);
+    void stop();
+    bool isRecording() const;
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+    void onLineAdded(int index);
+    void onPointsAppended(int index, int first, int count);
+    void writeEvent(const QString& text);
+
+private:
+    QPointer<LineChart> chart;
+    QFile file;
+    QTextStream stream;
+    QElapsedTimer clock;                    // 事件的时间戳
+};
+
+/// 回放的结果
+struct ReplayReport
+{
+    int events = 0;                         // 回放的事件数
+    int frames = 0;                         // 实际绘制的帧数
+    qint64 duration = 0;                    // 模拟时钟经过的时长(ms)
+    double paintP50 = 0, paintP90 = 0, paintP99 = 0, paintMax = 0; // 每帧绘制耗时的分位数(ms)
+    int animations = 0;                     // 启动的属性动画数量
+    int interactingFrames = 0;              // 动画或拖动中绘制的帧数
+
+    QString toString() const;
+};
+
+/**
+ * 以模拟时钟回放 ChartRecorder 记录的文件
+ * 属性动画由模拟时钟驱动，每帧（默认16ms）推进一次再处理绘制，结果与实际运行速度无关
+ * 可在无界面环境中使用（-platform offscreen），用于比较不同版本的绘制耗时
+ */
+class ChartReplayer : public QObject
+{
+    Q_OBJECT
+public:
+    ChartReplayer(LineChart* chart, QObject* parent = nullptr);
+
+    bool replay(const QString& path, int frameInterval = 16);
+    const ReplayReport& getReport() const;
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+    bool readSnapshot(QTextStream& in);
+    void addRecordedLine(const QStringList& fields, const QString& title, const QList<QPoint>& points);
+    void replayEvent(const QStringList& fields);
+    void runFrame();
+    void countAnimations();
+
+private:
+    QPointer<LineChart> chart;
+    ReplayReport report;
+    QList<double> paintTimes;               // 每一帧的绘制耗时(ms)
+    QList<QPointer<QObject>> newChildren;   // 新增的子对象，构造完成后再判断是否为动画
+    bool painting = false;
+};
+
+#endif // CHARTRECORDER_H
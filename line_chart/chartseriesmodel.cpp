@@ -0,0 +1,1070 @@
+#include "chartseriesmodel.h"
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+/// 字符串占用的内存：头部加上按容量计算的字符
+qint64 stringBytes(const QString& text)
+{
+    return qint64(sizeof(QArrayData)) + (text.capacity() + 1) * qint64(sizeof(QChar));
+}
+}
+
+ChartSeriesModel::ChartSeriesModel(QObject *parent) : QObject(parent)
+{
+}
+
+int ChartSeriesModel::lineCount() const
+{
+    return datas.size();
+}
+
+const ChartData &ChartSeriesModel::line(int index) const
+{
+    return datas.at(index);
+}
+
+/// 需要在修改后依旧保持不变的快照，直接拷贝返回值即可（写时复制）
+const QList<ChartData> &ChartSeriesModel::lines() const
+{
+    return datas;
+}
+
+const QList<QString> &ChartSeriesModel::getXLabels() const
+{
+    return xLabels;
+}
+
+const QList<int> &ChartSeriesModel::getXLabelPoss() const
+{
+    return xLabelPoss;
+}
+
+/// 传入的数据只增加引用计数；调用者不再需要时用 std::move 传入，不会复制任何点
+/// 由模型维护的部分（压缩历史、汇总的桶、外部数组、派生与重排的状态）不会沿用：
+/// 比如 addLine(model->line(i)) 复制一条线时，这些点展开到 points 中（已换出到磁盘的除外），派生折线变为普通折线
+/// 压缩、保留策略等需要重新设置
+void ChartSeriesModel::addLine(ChartData data)
+{
+    const ChartData& in = data;
+    if (in.external.isValid() || !in.history.isEmpty() || !in.rollup.isEmpty() || !in.reorderBuffer.isEmpty())
+    {
+        QList<QPoint> points;
+        QList<QPair<int, int>> missing;
+        data.history.setStore(nullptr); // 不属于这个模型，不读取磁盘
+        in.rollup.collect(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 0, points);
+        in.history.collect(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 0, points, &missing);
+        if (in.external.isValid())
+        {
+            for (int i = 0; i < in.external.count; i++)
+                points.append(in.external.at(i));
+        }
+        else
+        {
+            points.append(in.points);
+        }
+        points.append(in.reorderBuffer);
+        if (!missing.isEmpty())
+            qWarning() << "复制的折线中换出到磁盘的部分没有复制：" << missing;
+        if (in.xLabels.size() != points.size())
+            data.xLabels.clear();
+        data.points = points;
+    }
+    data.history = SeriesHistory();
+    data.rollup = SeriesRollup();
+    data.external = ExternalSeries();
+    data.derivedSource = -1;
+    data.derived = DerivedSeries();
+    data.reorderBuffer.clear();
+    data.ingest = IngestStatistics();
+    insertLine(std::move(data));
+}
+
+/// 加入一条折线，模型维护的部分由调用者（attachSeries、addDerivedLine 等）设置好
+void ChartSeriesModel::insertLine(ChartData data)
+{
+    // 只读访问：非 const 的遍历会使与调用者共享的点列表整个复制一份
+    const ChartData& in = data;
+    const int count = in.external.isValid() ? in.external.count : in.points.size();
+    auto pointAt = [&](int i) {
+        return in.external.isValid() ? in.external.at(i) : in.points.at(i);
+    };
+
+    // 检查数据有效性
+    if (count)
+    {
+        QPoint first = pointAt(0);
+        if (data.xMin == data.xMax)
+        {
+            data.xMin = data.xMax = first.x();
+            for (int i = 0; i < count; i++)
+            {
+                const int x = pointAt(i).x();
+                if (data.xMin > x)
+                    data.xMin = x;
+                else if (data.xMax < x)
+                    data.xMax = x;
+            }
+        }
+        if (data.yMin == data.yMax)
+        {
+            data.yMin = data.yMax = first.y();
+            for (int i = 0; i < count; i++)
+            {
+                const int y = pointAt(i).y();
+                if (data.yMin > y)
+                    data.yMin = y;
+                else if (data.yMax < y)
+                    data.yMax = y;
+            }
+        }
+    }
+    Q_ASSERT(in.xLabels.empty() || in.xLabels.size() == count);
+
+    // 新的label集合插入到现有X轴label中（多条数据融合）
+    int index = 0;
+    for (int i = 0; i < in.xLabels.size(); i++)
+    {
+        int x = pointAt(i).x();
+        const QString& label = in.xLabels.at(i);
+        while (index < xLabels.size() && xLabelPoss.at(index) < x)
+            index++;
+        if (index >= xLabels.size()) // x超出范围了
+        {
+            xLabels.append(label);
+            xLabelPoss.append(x);
+        }
+        else if (xLabelPoss.at(index) == x) // 一样的x，新的label，跳过
+        {
+            continue;
+        }
+        else if (xLabelPoss.at(index) > x)
+        {
+            xLabels.insert(index, label);
+            xLabelPoss.insert(index, x);
+        }
+        else
+        {
+            qWarning() << in.points;
+            qWarning() << in.xLabels;
+            qWarning() << this->xLabels;
+            qWarning() << this->xLabelPoss;
+            qWarning() << index << x;
+            Q_ASSERT(false);
+        }
+    }
+
+    if (in.external.isValid())
+        data.rangeIndex.build(in.external.ys, in.external.count);
+    else
+        data.rangeIndex.build(in.points);
+    data.history.setStore(store);
+    datas.append(std::move(data));
+    emit lineAdded(datas.size() - 1);
+}
+
+/// 添加一条直接使用调用者数组的折线，不复制、不转换为 QPoint
+/// 调用者保证 xs/ys 在 removeLine 之前一直有效且X递增；
+/// 原地修改后调用 seriesChanged，追加后调用 seriesAppended，换了数组调用 setSeriesBuffer
+/// 快照会拷贝一份，异步保存期间调用者仍然可以修改或释放这些数组
+int ChartSeriesModel::attachSeries(const int *xs, const int *ys, int count, QColor color, const QString &title)
+{
+    ChartData data;
+    data.title = title;
+    data.color = color;
+    data.external.xs = xs;
+    data.external.ys = ys;
+    data.external.count = xs && ys ? count : 0;
+    insertLine(std::move(data));
+    return datas.size() - 1;
+}
+
+/// 以移动的方式接管数组（比如采集线程填好后交出），同样不复制
+int ChartSeriesModel::adoptSeries(QVector<int> &&xs, QVector<int> &&ys, QColor color, const QString &title)
+{
+    Q_ASSERT(xs.size() == ys.size());
+    ChartData data;
+    data.title = title;
+    data.color = color;
+    data.external.ownedX = std::move(xs);
+    data.external.ownedY = std::move(ys);
+    data.external.xs = data.external.ownedX.constData();
+    data.external.ys = data.external.ownedY.constData();
+    data.external.count = qMin(data.external.ownedX.size(), data.external.ownedY.size());
+    insertLine(std::move(data));
+    return datas.size() - 1;
+}
+
+/// 外部数组换了位置或者长度（比如双缓冲交换），整条线重新绘制
+void ChartSeriesModel::setSeriesBuffer(int index, const int *xs, const int *ys, int count)
+{
+    Q_ASSERT(index < datas.size() && datas.at(index).external.isValid());
+    ExternalSeries& external = datas[index].external;
+    if (xs != external.ownedX.constData())
+        external.ownedX.clear();
+    if (ys != external.ownedY.constData())
+        external.ownedY.clear();
+    external.xs = xs;
+    external.ys = ys;
+    external.count = xs && ys ? count : 0;
+    datas[index].rangeIndex.build(external.ys, external.count);
+    rebuildDerived(index);
+    emit pointsChanged(index, 0, external.count);
+}
+
+/// 调用者在同一个数组的末尾写入了新的点，现在共 count 个
+void ChartSeriesModel::seriesAppended(int index, int count)
+{
+    Q_ASSERT(index < datas.size() && datas.at(index).external.isValid());
+    ExternalSeries& external = datas[index].external;
+    const int first = external.count;
+    if (count <= first)
+        return ;
+    external.count = count;
+    for (int k = first; k < count; k++)
+        datas[index].rangeIndex.append(external.ys[k]);
+    emit pointsAppended(index, first, count - first);
+
+    for (int i = 0; i < datas.size(); i++)
+        if (datas.at(i).derivedSource == index)
+            for (int k = first; k < count; k++)
+                ingestPoint(i, external.xs[k], datas[i].derived.push(external.at(k)));
+}
+
+/// 调用者原地修改了 [first, first + count) 的点
+void ChartSeriesModel::seriesChanged(int index, int first, int count)
+{
+    Q_ASSERT(index < datas.size() && datas.at(index).external.isValid());
+    ChartData& line = datas[index];
+    const ExternalSeries& external = line.external;
+    first = qBound(0, first, external.count);
+    count = qBound(0, count, external.count - first);
+    if (!count)
+        return ;
+    // 索引从修改的位置开始重新添加（大多数修改在尾部附近）
+    RangeIndex& rangeIndex = line.rangeIndex;
+    rangeIndex.truncate(first);
+    for (int k = rangeIndex.size(); k < external.count; k++)
+        rangeIndex.append(external.ys[k]);
+    rebuildDerived(index);
+    emit pointsChanged(index, first, count);
+}
+
+void ChartSeriesModel::removeLine(int index)
+{
+    Q_ASSERT(index < datas.size());
+    datas[index].history.clear();
+    datas.removeAt(index);
+    // 派生自被删除折线的，保留已有的点但不再更新
+    for (int i = 0; i < datas.size(); i++)
+    {
+        int& source = datas[i].derivedSource;
+        if (source == index)
+            source = -1;
+        else if (source > index)
+            source--;
+    }
+    emit lineRemoved(index);
+}
+
+void ChartSeriesModel::addPoint(int index, int x, int y)
+{
+    Q_ASSERT(index < datas.size());
+    emit pointIngested(index, x, y);
+    ingestPoint(index, x, y);
+}
+
+void ChartSeriesModel::addPoint(int index, int x, int y, const QString &label)
+{
+    Q_ASSERT(index < datas.size());
+    insertXLabel(x, label);
+    emit pointIngested(index, x, y);
+    ingestPoint(index, x, y);
+}
+
+/// 批量追加，只发出一次 pointsAppended
+/// X可以乱序：有重排窗口时先在缓冲中排序，否则（以及超出窗口的点）插入到已有数据中
+void ChartSeriesModel::addPoints(int index, const QList<QPoint> &points)
+{
+    Q_ASSERT(index < datas.size());
+    if (points.isEmpty())
+        return ;
+    emit pointsIngested(index, points);
+    ingestPoints(index, points);
+}
+
+/// 追加一个点（addPoint 与派生折线共用）
+void ChartSeriesModel::ingestPoint(int index, int x, int y)
+{
+    ChartData& line = datas[index];
+    if (line.external.isValid())
+    {
+        qWarning() << "外部数组的折线只读，请写入数组后调用 seriesAppended";
+        return ;
+    }
+    int last = 0;
+    if (line.reorderWindow > 0 || (lastX(index, last) && x < last)) // 乱序的点
+    {
+        ingestPoints(index, QList<QPoint>{QPoint(x, y)});
+        return ;
+    }
+    line.points.append(QPoint(x, y));
+    line.rangeIndex.append(y);
+    emit pointsAppended(index, line.points.size() - 1, 1);
+    sealHistory(index);
+    applyRetention(index);
+
+    // 派生自这条线的折线，各自增量计算一个新的点
+    for (int i = 0; i < datas.size(); i++)
+        if (datas.at(i).derivedSource == index)
+            ingestPoint(i, x, datas[i].derived.push(QPoint(x, y)));
+}
+
+/// 批量追加（addPoints 与派生折线共用）
+void ChartSeriesModel::ingestPoints(int index, const QList<QPoint> &points)
+{
+    if (points.isEmpty())
+        return ;
+    if (datas.at(index).external.isValid())
+    {
+        qWarning() << "外部数组的折线只读，请写入数组后调用 seriesAppended";
+        return ;
+    }
+    int last = 0;
+    bool hasLast = lastX(index, last);
+    if (datas.at(index).reorderWindow <= 0)
+    {
+        // 按顺序的连续部分一次追加，早于已有数据的逐个插入
+        QList<QPoint> run;
+        for (const QPoint& p: points)
+        {
+            if (!hasLast || p.x() >= last)
+            {
+                run.append(p);
+                last = p.x();
+                hasLast = true;
+                continue;
+            }
+            appendPoints(index, run);
+            run.clear();
+            insertLate(index, p);
+        }
+        appendPoints(index, run);
+        return ;
+    }
+
+    ChartData& line = datas[index];
+    QList<QPoint> late;
+    for (const QPoint& p: points)
+    {
+        if (hasLast && p.x() < last) // 已经提交过更大的X，超出了重排窗口
+        {
+            late.append(p);
+            continue;
+        }
+        int pos = upperBoundX(line.reorderBuffer, p.x());
+        if (pos < line.reorderBuffer.size())
+            line.ingest.reordered++;
+        line.reorderBuffer.insert(pos, p);
+    }
+    commitReorder(index, line.reorderBuffer.last().x() - line.reorderWindow);
+    for (const QPoint& p: late)
+        insertLate(index, p);
+}
+
+/// 立即提交重排缓冲中所有的点
+void ChartSeriesModel::flushReorder(int index)
+{
+    Q_ASSERT(index < datas.size());
+    emit reorderFlushed(index);
+    commitReorder(index, std::numeric_limits<int>::max());
+}
+
+/// 设置重排窗口（X跨度）：新的点先在缓冲中按X排序，比最新的点早超过 window 时才提交
+/// 窗口内乱序到达的点不需要插入，追加的代价不变；为0时关闭并提交缓冲中的点
+void ChartSeriesModel::setReorderWindow(int index, int window)
+{
+    Q_ASSERT(index < datas.size());
+    ChartData& line = datas[index];
+    line.reorderWindow = qMax(window, 0);
+    emit reorderWindowChanged(index, line.reorderWindow);
+    if (!line.reorderWindow)
+        commitReorder(index, std::numeric_limits<int>::max());
+    else if (!line.reorderBuffer.isEmpty())
+        commitReorder(index, line.reorderBuffer.last().x() - line.reorderWindow);
+}
+
+IngestStatistics ChartSeriesModel::ingestStatistics(int index) const
+{
+    const ChartData& line = datas.at(index);
+    IngestStatistics stat = line.ingest;
+    stat.pending = line.reorderBuffer.size();
+    return stat;
+}
+
+/// 移除最早的一个点；有汇总的桶时先移除最早的桶
+void ChartSeriesModel::removeFirst(int index)
+{
+    Q_ASSERT(index < datas.size());
+    emit firstRemoved(index);
+    ChartData& line = datas[index];
+    if (!line.rollup.isEmpty())
+    {
+        int firstX = 0;
+        const int count = line.rollup.removeFirst(firstX);
+        emit pointsEvicted(index, count, firstX);
+        trimXLabels();
+        return ;
+    }
+    evictRaw(index, std::numeric_limits<int>::max(), 1);
+}
+
+/// 添加一条派生自 source 的折线（移动平均、指数平均、滚动最值、滚动标准差）
+/// window 为点数，spanX 为true时为X跨度；与源数据的点一一对应
+/// 之后源数据每次追加或移除，派生折线只增量计算一个点；返回新折线的下标
+int ChartSeriesModel::addDerivedLine(int source, DerivedSeries::Type type, int window, bool spanX, QColor color, const QString &title)
+{
+    Q_ASSERT(source < datas.size());
+    ChartData data;
+    data.title = title;
+    data.color = color;
+    data.derivedSource = source;
+    data.derived.configure(type, window, spanX);
+
+    // 已有的数据只在这里计算一次
+    QList<QPoint> points;
+    collectPoints(source, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 0, points);
+    for (const QPoint& p: points)
+        data.points.append(QPoint(p.x(), data.derived.push(p)));
+    insertLine(std::move(data));
+    return datas.size() - 1;
+}
+
+/// 开启后，旧的点每 chunkSize 个压缩为一块，只有需要显示或查询时才解码
+/// cacheChunks 为解码缓存的块数，chunkSize 为0时关闭（已压缩的保持不变）
+void ChartSeriesModel::setCompression(int index, int chunkSize, int cacheChunks)
+{
+    Q_ASSERT(index < datas.size());
+    ChartData& line = datas[index];
+    if (line.external.isValid()) // 数组属于调用者，不能压缩
+        return ;
+    line.chunkSize = chunkSize > 0 ? qMax(chunkSize, 16) : 0;
+    line.history.setCacheLimit(cacheChunks);
+    sealHistory(index);
+}
+
+/// 设置保留策略：最近 rawHorizon 内保留原始点，更早的汇总到第一级，每级超出跨度后汇总到下一级
+/// 最后一级超出跨度的桶直接移除；每次追加后自动执行，不需要再调用 removeFirst
+/// 调用者数组的折线不能修改，忽略
+void ChartSeriesModel::setRetention(int index, const RetentionPolicy &policy)
+{
+    Q_ASSERT(index < datas.size());
+    ChartData& line = datas[index];
+    if (line.external.isValid())
+        return ;
+    const int before = line.rollup.pointCount();
+    line.rollup.setPolicy(policy);
+    emit retentionChanged(index);
+    if (line.rollup.pointCount() != before) // 已有的桶被重新汇总或丢弃
+    {
+        trimXLabels();
+        emit pointsChanged(index, -1, 0);
+    }
+    applyRetention(index);
+}
+
+HistoryStatistics ChartSeriesModel::historyStatistics(int index) const
+{
+    return datas.at(index).history.getStatistics();
+}
+
+/// 包括汇总与压缩部分在内的点的数量（每个汇总的桶显示为一到两个点）
+qint64 ChartSeriesModel::pointCount(int index) const
+{
+    const ChartData& line = datas.at(index);
+    return line.rollup.pointCount() + line.history.pointCount() + hotCount(index);
+}
+
+/// 第k个（从0开始）点的X
+bool ChartSeriesModel::headX(int index, int k, int &x) const
+{
+    const ChartData& line = datas.at(index);
+    if (k < line.rollup.pointCount())
+        return line.rollup.headX(k, x);
+    k -= line.rollup.pointCount();
+    if (k < line.history.pointCount())
+        return line.history.headX(k, x);
+    k -= int(line.history.pointCount());
+    if (k >= hotCount(index))
+        return false;
+    x = hotPoint(index, k).x();
+    return true;
+}
+
+/// 未压缩部分的点的数量，pointsAppended 的下标即为其中的下标
+int ChartSeriesModel::hotCount(int index) const
+{
+    const ChartData& line = datas.at(index);
+    return line.external.isValid() ? line.external.count : line.points.size();
+}
+
+/// 未压缩部分的第i个点
+QPoint ChartSeriesModel::hotPoint(int index, int i) const
+{
+    const ChartData& line = datas.at(index);
+    return line.external.isValid() ? line.external.at(i) : line.points.at(i);
+}
+
+/// 取出X在 [xFrom, xTo] 内的点，以及两侧各 extra 个点（用于连线与数值位置）
+/// 只有需要的压缩块才会被解码；out 清空时保留容量，便于调用者每帧复用
+/// 换出到磁盘的块在载入前跳过，其X范围放入 missing，载入后发出 historyLoaded
+/// 汇总的桶取其中最小值与最大值所在的点，与原始点连续
+/// resolution 为一个像素列对应的X跨度，比它还窄的压缩块同样以汇总代替（见 SeriesHistory::collect）
+void ChartSeriesModel::collectPoints(int index, int xFrom, int xTo, int extra, QList<QPoint> &out, QList<QPair<int, int>>* missing,
+                                     int resolution) const
+{
+    out.erase(out.begin(), out.end());
+    const ChartData& line = datas.at(index);
+    const ExternalSeries& external = line.external;
+    if (external.isValid()) // 只转换需要的范围
+    {
+        const int* end = external.xs + external.count;
+        int first = int(std::lower_bound(external.xs, end, xFrom) - external.xs);
+        int last = int(std::upper_bound(external.xs, end, xTo) - external.xs);
+        first = qMax(first - extra, 0);
+        last = qMin(last + extra, external.count);
+        out.reserve(last - first);
+        for (int i = first; i < last; i++)
+            out.append(external.at(i));
+        return ;
+    }
+    const QList<QPoint>& points = line.points;
+    int first = lowerBoundX(points, xFrom), last = upperBoundX(points, xTo);
+    // 汇总的桶：范围与之相交，或者范围左侧的原始点不足 extra 个
+    int x = 0;
+    const bool fewRaw = first < extra && (line.history.isEmpty() || !line.history.headX(extra - first - 1, x) || x >= xFrom);
+    if (!line.rollup.isEmpty() && (xFrom <= line.rollup.lastX() || fewRaw))
+        line.rollup.collect(xFrom, xTo, extra, out);
+    if (!line.history.isEmpty() && (xFrom <= line.history.lastX() || first < extra))
+        line.history.collect(xFrom, xTo, extra, out, missing, resolution);
+    first = qMax(first - extra, 0);
+    last = qMin(last + extra, points.size());
+    for (int i = first; i < last; i++)
+        out.append(points.at(i));
+}
+
+/// X在 [xFrom, xTo] 内的统计，包括压缩的部分
+RangeStatistics ChartSeriesModel::statistics(int index, int xFrom, int xTo) const
+{
+    const ChartData& line = datas.at(index);
+    RangeStatistics stat;
+    const ExternalSeries& external = line.external;
+    if (external.isValid()) // 二分查找X的范围，再查询索引
+    {
+        const int* end = external.xs + external.count;
+        int l = int(std::lower_bound(external.xs, end, xFrom) - external.xs);
+        int r = int(std::upper_bound(external.xs, end, xTo) - external.xs) - 1;
+        return line.rangeIndex.statistics(l, r);
+    }
+    if (!line.rollup.isEmpty() && xFrom <= line.rollup.lastX())
+        stat = line.rollup.statistics(xFrom, xTo);
+    if (!line.history.isEmpty() && xFrom <= line.history.lastX())
+        stat.merge(line.history.statistics(xFrom, xTo));
+    int l = lowerBoundX(line.points, xFrom);
+    int r = upperBoundX(line.points, xTo) - 1;
+    stat.merge(line.rangeIndex.statistics(l, r));
+    return stat;
+}
+
+
+/// 按顺序追加（X不小于已有的点）
+void ChartSeriesModel::appendPoints(int index, const QList<QPoint> &points)
+{
+    if (points.isEmpty())
+        return ;
+    ChartData& line = datas[index];
+    const int first = line.points.size();
+    for (const QPoint& p: points)
+    {
+        line.points.append(p);
+        line.rangeIndex.append(p.y());
+    }
+    emit pointsAppended(index, first, points.size());
+    sealHistory(index);
+    applyRetention(index);
+
+    for (int i = 0; i < datas.size(); i++)
+    {
+        if (datas.at(i).derivedSource != index)
+            continue;
+        QList<QPoint> derived;
+        derived.reserve(points.size());
+        for (const QPoint& p: points)
+            derived.append(QPoint(p.x(), datas[i].derived.push(p)));
+        ingestPoints(i, derived);
+    }
+}
+
+/// 提交重排缓冲中 X 不大于 xTo 的点
+void ChartSeriesModel::commitReorder(int index, int xTo)
+{
+    ChartData& line = datas[index];
+    const int count = upperBoundX(line.reorderBuffer, xTo);
+    if (!count)
+        return ;
+    QList<QPoint> ready = line.reorderBuffer.mid(0, count);
+    line.reorderBuffer.erase(line.reorderBuffer.begin(), line.reorderBuffer.begin() + count);
+    appendPoints(index, ready);
+}
+
+/// 插入一个早于最后一个点的点：未压缩的部分直接插入，压缩的部分重新编码所在的块
+/// 早于保留的第一个原始点、或者所在的块已换出到磁盘时丢弃；派生折线整体重算
+void ChartSeriesModel::insertLate(int index, const QPoint &p)
+{
+    ChartData& line = datas[index];
+    if (!line.rollup.isEmpty() && p.x() <= line.rollup.lastX()) // 已经汇总的部分不再修改
+    {
+        line.ingest.dropped++;
+        return ;
+    }
+    if (!line.points.isEmpty() && (line.history.isEmpty() || p.x() >= line.history.lastX()))
+    {
+        const int pos = upperBoundX(line.points, p.x());
+        line.points.insert(pos, p);
+        line.rangeIndex.truncate(pos);
+        for (int i = pos; i < line.points.size(); i++)
+            line.rangeIndex.append(line.points.at(i).y());
+        line.ingest.late++;
+        emit pointsChanged(index, pos, 1);
+        sealHistory(index);
+    }
+    else if (line.history.insert(p))
+    {
+        line.ingest.late++;
+        emit pointsChanged(index, -1, 0);
+        enforceMemoryBudget();
+    }
+    else
+    {
+        line.ingest.dropped++;
+        return ;
+    }
+    rebuildDerived(index);
+}
+
+/// 最后一个（已提交的）点的X
+bool ChartSeriesModel::lastX(int index, int &x) const
+{
+    const ChartData& line = datas.at(index);
+    if (hotCount(index))
+        x = hotPoint(index, hotCount(index) - 1).x();
+    else if (!line.history.isEmpty())
+        x = line.history.lastX();
+    else
+        return false;
+    return true;
+}
+
+/// 未压缩的点超过两块时，把最早的一块压缩封存
+void ChartSeriesModel::sealHistory(int index)
+{
+    ChartData& line = datas[index];
+    if (line.chunkSize <= 0)
+        return ;
+    while (line.points.size() >= line.chunkSize * 2)
+    {
+        line.history.append(line.points.mid(0, line.chunkSize));
+        line.points.erase(line.points.begin(), line.points.begin() + line.chunkSize);
+        for (int i = 0; i < line.chunkSize; i++)
+            line.rangeIndex.removeFirst();
+    }
+    enforceMemoryBudget();
+}
+
+/// 按保留策略：超出原始点跨度的点汇总后移除，各级超出跨度的桶汇总到下一级或移除
+/// 原始点只按第一级的桶整个汇总，每经过一个桶的宽度才执行一次
+void ChartSeriesModel::applyRetention(int index)
+{
+    ChartData& line = datas[index];
+    int last = 0;
+    if (!line.rollup.isEnabled() || line.external.isValid() || !lastX(index, last))
+        return ;
+    const int cutoff = line.rollup.rawCutoff(last);
+    auto rawFirstX = [&](int& x) {
+        const ChartData& data = datas.at(index);
+        if (!data.history.isEmpty())
+            x = data.history.firstX();
+        else if (!data.points.isEmpty())
+            x = data.points.first().x();
+        else
+            return false;
+        return true;
+    };
+
+    // 原始点：没有任何一级时直接移除；换出到磁盘尚未载入的块等载入后再汇总（见 onChunkLoaded）
+    // 压缩的部分全部移除后才处理未压缩的点，保证按X先后汇总
+    int firstX = 0;
+    if (rawFirstX(firstX) && firstX < cutoff)
+    {
+        const bool rollup = !line.rollup.getPolicy().tiers.isEmpty();
+        QList<QPoint> old;
+        int historyFirstX = 0;
+        const int count = line.history.takeBefore(cutoff, rollup ? &old : nullptr, historyFirstX);
+        if (rollup && line.history.isEmpty())
+            old += line.points.mid(0, lowerBoundX(line.points, cutoff));
+        line.rollup.add(old);
+        notifyEvicted(index, count, historyFirstX);
+        if (datas.at(index).history.isEmpty())
+            evictRaw(index, cutoff, std::numeric_limits<int>::max());
+        int nextX = last;
+        rawFirstX(nextX);
+        if (!old.isEmpty())
+            emit pointsRolledUp(index, firstX, nextX);
+    }
+
+    // 逐级汇总，最后一级超出的移除
+    int xFrom = 0, xTo = 0;
+    if (datas[index].rollup.cascade(last, xFrom, xTo))
+    {
+        if (xTo == std::numeric_limits<int>::max())
+            rawFirstX(xTo);
+        emit pointsRolledUp(index, xFrom, xTo);
+    }
+    const int count = datas[index].rollup.evict(last, firstX);
+    if (count)
+    {
+        emit pointsEvicted(index, count, firstX);
+        trimXLabels();
+    }
+}
+
+/// 移除X小于 xBefore 的原始点（压缩与未压缩的部分，不含汇总的桶），最多 maxCount 个
+/// 派生折线移除同样数量的点
+void ChartSeriesModel::evictRaw(int index, int xBefore, int maxCount)
+{
+    ChartData& line = datas[index];
+    int firstX = 0, count = 0;
+    while (count < maxCount)
+    {
+        int x = 0;
+        if (!line.history.isEmpty()) // 先移除压缩的部分
+        {
+            // 按X移除时需要确定的X：换出到磁盘的块正在载入，之后再移除；只按数量移除时不需要
+            if (xBefore != std::numeric_limits<int>::max() && !line.history.isFirstXExact())
+                break;
+            x = line.history.firstX();
+            if (x >= xBefore)
+                break;
+            line.history.removeFirst();
+        }
+        else if (line.external.isValid() && line.external.count > 0) // 视图向后移动一个点，数组本身不变
+        {
+            x = line.external.xs[0];
+            if (x >= xBefore)
+                break;
+            line.external.xs++;
+            line.external.ys++;
+            line.external.count--;
+            line.rangeIndex.removeFirst();
+        }
+        else if (!line.points.empty())
+        {
+            x = line.points.first().x();
+            if (x >= xBefore)
+                break;
+            line.points.removeFirst();
+            line.rangeIndex.removeFirst();
+        }
+        else
+        {
+            break;
+        }
+        if (!count)
+            firstX = x;
+        count++;
+    }
+    notifyEvicted(index, count, firstX);
+}
+
+/// 移除了 count 个原始点之后：通知、清理标签，派生折线移除同样数量的点
+void ChartSeriesModel::notifyEvicted(int index, int count, int firstX)
+{
+    if (!count)
+        return ;
+    emit pointsEvicted(index, count, firstX);
+    trimXLabels();
+
+    for (int i = 0; i < datas.size(); i++)
+    {
+        if (datas.at(i).derivedSource != index)
+            continue;
+        for (int k = 0; k < count; k++)
+            datas[i].derived.evictFirst();
+        evictRaw(i, std::numeric_limits<int>::max(), count);
+    }
+}
+
+/// 源数据被整体修改后，重新计算派生自它的折线
+void ChartSeriesModel::rebuildDerived(int source)
+{
+    QList<QPoint> points;
+    for (int i = 0; i < datas.size(); i++)
+    {
+        if (datas.at(i).derivedSource != source)
+            continue;
+        if (points.isEmpty())
+            collectPoints(source, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 0, points);
+        ChartData& line = datas[i];
+        line.derived.configure(line.derived.getType(), line.derived.getWindow(), line.derived.isSpanX());
+        line.history.clear();
+        line.points.clear();
+        for (const QPoint& p: points)
+            line.points.append(QPoint(p.x(), line.derived.push(p)));
+        line.rangeIndex.build(line.points);
+        sealHistory(i);
+        rebuildDerived(i);
+        emit pointsChanged(i, 0, hotCount(i));
+    }
+}
+
+/// 限制所有压缩历史在内存中的大小，超出时把最早的块写入磁盘临时文件
+/// 显示到这些块时在后台线程读取，读取完成前以占位图案显示；bytes 为0时不再换出
+void ChartSeriesModel::setMemoryBudget(qint64 bytes, const QString &directory)
+{
+    memoryBudget = bytes;
+    if (bytes > 0 && !store)
+    {
+        store = new ChunkStore(directory, this);
+        if (!store->isValid())
+        {
+            qWarning() << "无法创建换出文件，不限制内存";
+            delete store;
+            store = nullptr;
+            memoryBudget = 0;
+            return ;
+        }
+        connect(store, &ChunkStore::chunkLoaded, this, [=](quint64 id) {
+            onChunkLoaded(id);
+        });
+        for (int i = 0; i < datas.size(); i++)
+            datas[i].history.setStore(store);
+    }
+    enforceMemoryBudget();
+}
+
+/// 压缩历史在内存中的总大小
+qint64 ChartSeriesModel::residentBytes() const
+{
+    qint64 bytes = 0;
+    for (const ChartData& line: datas)
+        bytes += line.history.residentBytes();
+    return bytes;
+}
+
+/// 一条折线的内存占用
+SeriesMemory ChartSeriesModel::seriesMemory(int index) const
+{
+    const ChartData& line = datas.at(index);
+    SeriesMemory memory;
+    memory.points = line.points.size() * qint64(sizeof(void*)); // QList 的每一项占一个指针大小，QPoint 直接存放其中
+    memory.points += (line.external.ownedX.capacity() + line.external.ownedY.capacity()) * qint64(sizeof(int)); // 调用者持有的数组不计入
+    for (const QString& label: line.xLabels)
+        memory.labels += qint64(sizeof(void*)) + stringBytes(label);
+    memory.history = line.history.memoryBytes();
+    memory.rollup = line.rollup.memoryBytes();
+    memory.index = line.rangeIndex.memoryBytes();
+    return memory;
+}
+
+/// 所有折线共用的X轴标签的内存占用
+qint64 ChartSeriesModel::labelMemory() const
+{
+    qint64 bytes = xLabelPoss.size() * qint64(sizeof(void*));
+    for (const QString& label: xLabels)
+        bytes += qint64(sizeof(void*)) + stringBytes(label);
+    return bytes;
+}
+
+/// 每次从占用最多的折线换出最早的块，直到满足上限
+void ChartSeriesModel::enforceMemoryBudget()
+{
+    if (memoryBudget <= 0 || !store)
+        return ;
+    qint64 total = residentBytes();
+    while (total > memoryBudget)
+    {
+        int most = -1;
+        qint64 mostBytes = 0;
+        for (int i = 0; i < datas.size(); i++)
+        {
+            qint64 bytes = datas.at(i).history.residentBytes();
+            if (bytes > mostBytes)
+            {
+                most = i;
+                mostBytes = bytes;
+            }
+        }
+        if (most < 0 || !datas[most].history.spillOldest())
+            break;
+        total -= mostBytes - datas.at(most).history.residentBytes();
+    }
+}
+
+/// 换出的块载入了：通知所在的折线与X范围，并继续之前因为等待它而暂停的按X移除
+void ChartSeriesModel::onChunkLoaded(quint64 id)
+{
+    for (int i = 0; i < datas.size(); i++)
+    {
+        int xFrom = 0, xTo = 0;
+        if (!datas.at(i).history.chunkRange(id, xFrom, xTo))
+            continue;
+        emit historyLoaded(i, xFrom, xTo);
+        applyRetention(i);
+        return ;
+    }
+}
+
+/// 通知其他关联的折线图同步X轴范围
+void ChartSeriesModel::linkXRange(int xMin, int xMax, QObject *source)
+{
+    emit xRangeLinked(xMin, xMax, source);
+}
+
+/// 当前数据的快照，只是增加引用计数（调用者持有的外部数组除外）
+SeriesSnapshot ChartSeriesModel::takeSnapshot() const
+{
+    SeriesSnapshot snapshot;
+    snapshot.datas = datas;
+    // 调用者持有的数组可能在后台写入期间被修改或释放，拷贝一份；adoptSeries 移交的数组由快照共享
+    for (int i = 0; i < datas.size(); i++)
+    {
+        const ExternalSeries& from = datas.at(i).external;
+        if (!from.isValid() || from.isOwned())
+            continue;
+        ExternalSeries& external = snapshot.datas[i].external;
+        external.ownedX.resize(from.count);
+        external.ownedY.resize(from.count);
+        std::copy(from.xs, from.xs + from.count, external.ownedX.begin());
+        std::copy(from.ys, from.ys + from.count, external.ownedY.begin());
+        external.xs = external.ownedX.constData();
+        external.ys = external.ownedY.constData();
+    }
+    snapshot.xLabels = xLabels;
+    snapshot.xLabelPoss = xLabelPoss;
+    if (store)
+        snapshot.spill = store->view();
+    return snapshot;
+}
+
+/// 把快照写入数据流：点直接写入内存中的原始字节，压缩块原样写入
+/// 不访问模型本身，可在其他线程中调用
+bool ChartSeriesModel::writeSnapshot(QDataStream &out, const SeriesSnapshot &snapshot)
+{
+    out << snapshot.xLabels << snapshot.xLabelPoss << quint32(snapshot.datas.size());
+    for (const ChartData& data: snapshot.datas)
+    {
+        out << data.title << data.color << data.xMin << data.xMax << data.yMin << data.yMax
+            << data.rasterLine << data.chunkSize << data.xLabels << data.derivedSource;
+        data.derived.save(out);
+        // 外部数组的点写成普通的点，恢复后为普通折线
+        QVector<QPoint> raw = data.points.toVector();
+        if (data.external.isValid())
+        {
+            raw.resize(data.external.count);
+            for (int i = 0; i < data.external.count; i++)
+                raw[i] = data.external.at(i);
+        }
+        out << quint32(raw.size());
+        out.writeRawData(reinterpret_cast<const char*>(raw.constData()), raw.size() * int(sizeof(QPoint)));
+        if (!data.history.save(out, &snapshot.spill))
+            return false;
+        data.rollup.save(out);
+    }
+    return out.status() == QDataStream::Ok;
+}
+
+/// 从快照整体替换所有数据，不逐个添加点，完成后发出 modelReset
+/// 数据有误时返回false，现有数据保持不变
+bool ChartSeriesModel::restoreSnapshot(QDataStream &in)
+{
+    QList<QString> labels;
+    QList<int> labelPoss;
+    quint32 lineCount = 0;
+    in >> labels >> labelPoss >> lineCount;
+    if (in.status() != QDataStream::Ok || labels.size() != labelPoss.size())
+        return false;
+
+    QList<ChartData> lines;
+    for (quint32 i = 0; i < lineCount; i++)
+    {
+        ChartData data;
+        quint32 pointCount = 0;
+        in >> data.title >> data.color >> data.xMin >> data.xMax >> data.yMin >> data.yMax
+           >> data.rasterLine >> data.chunkSize >> data.xLabels >> data.derivedSource;
+        if (!data.derived.load(in) || data.derivedSource >= int(i)) // 源折线总是在派生折线之前
+            return false;
+        in >> pointCount;
+        const qint64 bytes = qint64(pointCount) * qint64(sizeof(QPoint));
+        if (in.status() != QDataStream::Ok || (in.device() && bytes > in.device()->bytesAvailable()))
+            return false;
+        QVector<QPoint> raw(int(pointCount));
+        if (in.readRawData(reinterpret_cast<char*>(raw.data()), int(bytes)) != bytes)
+            return false;
+        data.points = QList<QPoint>::fromVector(raw);
+        if (!data.history.load(in) || !data.rollup.load(in))
+            return false;
+        data.rangeIndex.build(data.points);
+        data.history.setStore(store);
+        lines.append(data);
+    }
+
+    for (int i = 0; i < datas.size(); i++)
+        datas[i].history.clear();
+    datas = lines;
+    xLabels = labels;
+    xLabelPoss = labelPoss;
+    enforceMemoryBudget();
+    emit modelReset();
+    return true;
+}
+
+/// 移除所有折线的第一个点之前的标签（已经没有点与之对应），所有折线都为空时全部移除
+/// 否则持续添加与移除时标签会无限增长
+void ChartSeriesModel::trimXLabels()
+{
+    bool found = false;
+    int minX = 0;
+    for (int i = 0; i < datas.size(); i++)
+    {
+        int x = 0;
+        if (headX(i, 0, x))
+        {
+            minX = found ? qMin(minX, x) : x;
+            found = true;
+        }
+    }
+    int count = 0;
+    while (count < xLabelPoss.size() && (!found || xLabelPoss.at(count) < minX))
+        count++;
+    if (!count)
+        return ;
+    xLabels.erase(xLabels.begin(), xLabels.begin() + count);
+    xLabelPoss.erase(xLabelPoss.begin(), xLabelPoss.begin() + count);
+    emit xLabelsChanged();
+}
+
+/// 按X顺序插入label，已有相同X的则忽略
+void ChartSeriesModel::insertXLabel(int x, const QString &label)
+{
+    emit xLabelIngested(x, label);
+    int i = xLabels.size() - 1;
+    while (i >= 0 && xLabelPoss.at(i) > x)
+        i--;
+    if (i >= 0 && xLabelPoss.at(i) == x)
+        return ;
+    xLabels.insert(i + 1, label);
+    xLabelPoss.insert(i + 1, x);
+    emit xLabelsChanged();
+}
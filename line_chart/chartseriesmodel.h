@@ -0,0 +1,205 @@
+#ifndef CHARTSERIESMODEL_H
+#define CHARTSERIESMODEL_H
+
+#include <QObject>
+#include <QList>
+#include <QColor>
+#include <QPoint>
+#include <QVector>
+#include "rangeindex.h"
+#include "pointsearch.h"
+#include "serieshistory.h"
+#include "seriesrollup.h"
+#include "derivedseries.h"
+#include "chunkstore.h"
+
+/// 模型数据的快照（写时复制的拷贝），可以交给其他线程写入文件
+struct SeriesSnapshot
+{
+    QList<ChartData> datas;
+    QList<QString> xLabels;
+    QList<int> xLabelPoss;
+    ChunkStoreView spill;                   // 换出到磁盘的块，持有期间文件不会被删除或改写
+};
+
+/// 一条折线占用的内存（字节，按容量估算）
+struct SeriesMemory
+{
+    qint64 points = 0;                      // 未压缩的点
+    qint64 labels = 0;                      // 这条线自带的X标签
+    qint64 history = 0;                     // 压缩历史与解码缓存
+    qint64 index = 0;                       // 区间统计索引
+    qint64 rollup = 0;                      // 分级汇总的桶
+
+    qint64 total() const
+    {
+        return points + labels + history + index + rollup;
+    }
+};
+
+/**
+ * 调用者持有的连续X/Y数组（零拷贝），或者通过移动交给模型的数组
+ * 只是视图：调用者要保证数组在 removeLine 之前一直有效，原地修改后通知模型
+ */
+struct ExternalSeries
+{
+    const int* xs = nullptr;                // X需要递增
+    const int* ys = nullptr;
+    int count = 0;
+    QVector<int> ownedX, ownedY;            // adoptSeries 移交的数组（或快照中的拷贝），xs/ys 指向其中
+
+    bool isValid() const
+    {
+        return xs && ys;
+    }
+
+    /// xs/ys 是否都指向模型自己的数组（而不是调用者持有的）
+    bool isOwned() const
+    {
+        return xs >= ownedX.constData() && xs <= ownedX.constData() + ownedX.size()
+                && ys >= ownedY.constData() && ys <= ownedY.constData() + ownedY.size()
+                && !ownedX.isEmpty() && !ownedY.isEmpty();
+    }
+
+    QPoint at(int i) const
+    {
+        return QPoint(xs[i], ys[i]);
+    }
+};
+
+/// 乱序到达的点的统计
+struct IngestStatistics
+{
+    qint64 reordered = 0;                   // 在重排窗口内被排到正确位置的点
+    qint64 late = 0;                        // 早于已提交的点，插入到已有数据中的点
+    qint64 dropped = 0;                     // 太旧（早于保留的第一个点，或所在块已换出）而丢弃的点
+    int pending = 0;                        // 仍在重排缓冲中等待提交的点
+};
+
+struct ChartData
+{
+    QString title;
+    QColor color = Qt::black;
+    int xMin = 0;
+    int xMax = 0;
+    int yMin = 0;
+    int yMax = 0;
+    QList<QPoint> points;
+    QList<QString> xLabels; // X显示的名字，可空，比如日期
+    bool rasterLine = false;// 直线连线时强制使用光栅快速绘制（无抗锯齿）
+    RangeIndex rangeIndex;  // Y值的区间统计索引，由模型维护（未压缩的部分：points 或外部数组）
+    int chunkSize = 0;      // 大于0时，旧的点每这么多个压缩封存到 history
+    SeriesHistory history;  // 压缩封存的旧点，X都不大于 points 中的点
+    SeriesRollup rollup;    // 保留策略与汇总的桶，X都小于 history 与 points 中的点
+    int derivedSource = -1; // 派生自哪条线（随之增量更新），-1为普通折线
+    DerivedSeries derived;  // 派生值的增量计算状态
+    ExternalSeries external;// 有效时点来自外部数组而不是 points，只读
+    int reorderWindow = 0;  // 重排窗口（X跨度），大于0时新的点先在缓冲中排序
+    QList<QPoint> reorderBuffer; // 尚未提交的点，按X排序；不在快照中
+    IngestStatistics ingest;// 乱序到达的统计
+};
+
+/**
+ * 折线数据模型，可以被多个 LineChart 同时使用（比如总览图 + 多个细节图）
+ * 数据保存在隐式共享的 QList 中，外部通过 lines() 拷贝得到的是写时复制的快照
+ * 修改后发出细粒度的信号，各个折线图只刷新受影响的部分
+ */
+class ChartSeriesModel : public QObject
+{
+    Q_OBJECT
+public:
+    ChartSeriesModel(QObject *parent = nullptr);
+
+    int lineCount() const;
+    const ChartData& line(int index) const;
+    const QList<ChartData>& lines() const;
+    const QList<QString>& getXLabels() const;
+    const QList<int>& getXLabelPoss() const;
+
+    void addLine(ChartData data);
+    void removeLine(int index);
+    void addPoint(int index, int x, int y);
+    void addPoint(int index, int x, int y, const QString& label);
+    void addPoints(int index, const QList<QPoint>& points);
+    void insertXLabel(int x, const QString& label);
+    void removeFirst(int index);
+    int attachSeries(const int* xs, const int* ys, int count, QColor color = Qt::black, const QString& title = QString());
+    int adoptSeries(QVector<int>&& xs, QVector<int>&& ys, QColor color = Qt::black, const QString& title = QString());
+    void setSeriesBuffer(int index, const int* xs, const int* ys, int count);
+    void seriesAppended(int index, int count);
+    void seriesChanged(int index, int first, int count);
+    void setReorderWindow(int index, int window);
+    void flushReorder(int index);
+    IngestStatistics ingestStatistics(int index) const;
+    int addDerivedLine(int source, DerivedSeries::Type type, int window, bool spanX = false,
+                       QColor color = Qt::gray, const QString& title = QString());
+
+    void setCompression(int index, int chunkSize, int cacheChunks = 16);
+    void setRetention(int index, const RetentionPolicy& policy);
+    HistoryStatistics historyStatistics(int index) const;
+    qint64 pointCount(int index) const;
+    bool headX(int index, int k, int& x) const;
+    int hotCount(int index) const;
+    QPoint hotPoint(int index, int i) const;
+    void collectPoints(int index, int xFrom, int xTo, int extra, QList<QPoint>& out, QList<QPair<int, int>>* missing = nullptr,
+                       int resolution = 0) const;
+    RangeStatistics statistics(int index, int xFrom, int xTo) const;
+
+    void setMemoryBudget(qint64 bytes, const QString& directory = QString());
+    qint64 residentBytes() const;
+    SeriesMemory seriesMemory(int index) const;
+    qint64 labelMemory() const;
+
+    void linkXRange(int xMin, int xMax, QObject* source);
+
+    SeriesSnapshot takeSnapshot() const;
+    static bool writeSnapshot(QDataStream& out, const SeriesSnapshot& snapshot);
+    bool restoreSnapshot(QDataStream& in);
+
+signals:
+    void lineAdded(int index);
+    void lineRemoved(int index);
+    void pointsAppended(int index, int first, int count);
+    void pointsEvicted(int index, int count, int firstX); // firstX：被移除的第一个点的X
+    void pointsChanged(int index, int first, int count); // 点被原地修改或插入；first 为-1表示压缩的部分
+    void pointsRolledUp(int index, int xFrom, int xTo); // [xFrom, xTo) 内的点被汇总，显示的形状变化
+    void xRangeLinked(int xMin, int xMax, QObject* source);
+    void xLabelsChanged();
+    void historyLoaded(int index, int xFrom, int xTo); // 换出到磁盘的块异步载入完成，[xFrom, xTo] 为其X范围
+    void modelReset();                      // 整体替换了所有数据（从快照恢复）
+
+    // 调用者通过接口发出的请求（用于录制），派生、汇总、重排等内部产生的变化不会发出
+    void pointIngested(int index, int x, int y);
+    void xLabelIngested(int x, const QString& label);
+    void pointsIngested(int index, const QList<QPoint>& points);
+    void firstRemoved(int index);
+    void reorderWindowChanged(int index, int window);
+    void reorderFlushed(int index);
+    void retentionChanged(int index);
+
+private:
+    void insertLine(ChartData data);
+    void ingestPoint(int index, int x, int y);
+    void ingestPoints(int index, const QList<QPoint>& points);
+    void appendPoints(int index, const QList<QPoint>& points);
+    void commitReorder(int index, int xTo);
+    void insertLate(int index, const QPoint& p);
+    bool lastX(int index, int& x) const;
+    void sealHistory(int index);
+    void applyRetention(int index);
+    void evictRaw(int index, int xBefore, int maxCount);
+    void notifyEvicted(int index, int count, int firstX);
+    void trimXLabels();
+    void rebuildDerived(int source);
+    void enforceMemoryBudget();
+    void onChunkLoaded(quint64 id);
+
+private:
+    QList<ChartData> datas;                 // 所有折线的数据
+    QList<QString> xLabels;                 // 显示的文字（可能少于值数量）
+    QList<int> xLabelPoss;
+    qint64 memoryBudget = 0;                // 压缩历史在内存中的上限，0为不限制
+    ChunkStore* store = nullptr;            // 超出上限时换出的磁盘存储
+};
+
+#endif // CHARTSERIESMODEL_H
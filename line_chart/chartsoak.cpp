@@ -0,0 +1,221 @@
+#include "chartsoak.h"
+#include <QApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <algorithm>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace
+{
+/// 中位数，会排序传入的列表
+double median(QList<double>& values)
+{
+    if (values.isEmpty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values.at(values.size() / 2);
+}
+}
+
+ChartSoak::ChartSoak(LineChart *chart, const SoakOptions &options, QObject *parent)
+    : QObject(parent), chart(chart), options(options)
+{
+    this->options.lines = qMax(options.lines, 1);
+    this->options.rate = qMax(options.rate, 1);
+    this->options.window = qMax(options.window, 2);
+    this->options.sampleInterval = qMax(options.sampleInterval, 10);
+
+    // 点数较多时每次添加多个，定时器最快1ms
+    const int interval = qBound(1, 1000 / this->options.rate, 1000);
+    pointsPerTick = qMax(this->options.rate * interval / 1000, 1);
+    feedTimer.setInterval(interval);
+    feedTimer.setTimerType(Qt::PreciseTimer);
+    connect(&feedTimer, &QTimer::timeout, this, &ChartSoak::feed);
+    sampleTimer.setInterval(this->options.sampleInterval);
+    connect(&sampleTimer, &QTimer::timeout, this, &ChartSoak::sample);
+}
+
+/// 运行 duration 秒后分析采样结果，返回是否通过
+bool ChartSoak::run()
+{
+    samples.clear();
+    failures.clear();
+    if (!chart)
+        return false;
+    for (int i = chart->lineCount(); i < options.lines; i++)
+    {
+        ChartData data;
+        data.title = QString("soak %1").arg(i);
+        data.color = QColor::fromHsv(i * 360 / options.lines, 200, 220);
+        chart->addLine(data);
+    }
+
+    chart->installEventFilter(this);
+    QEventLoop loop;
+    QTimer::singleShot(options.duration * 1000, &loop, &QEventLoop::quit);
+    clock.start();
+    feedTimer.start();
+    sampleTimer.start();
+    loop.exec();
+    feedTimer.stop();
+    sampleTimer.stop();
+    if (chart)
+        chart->removeEventFilter(this);
+
+    sample();
+    analyze();
+    return failures.isEmpty();
+}
+
+const QList<SoakSample> &ChartSoak::getSamples() const
+{
+    return samples;
+}
+
+const QStringList &ChartSoak::getFailures() const
+{
+    return failures;
+}
+
+/// 第一次与最后一次采样，以及不通过的原因
+QString ChartSoak::toString() const
+{
+    if (samples.isEmpty())
+        return "no samples";
+    auto line = [](const SoakSample& s) {
+        return QString("%1 s: rss %2 KB, objects %3, chart objects %4, animations %5, labels %6, points %7, chart memory %8 KB, paint %9 ms")
+                .arg(s.time / 1000).arg(s.rss / 1024).arg(s.objects).arg(s.chart.objects).arg(s.chart.animations)
+                .arg(s.chart.labels).arg(s.chart.points).arg(s.chart.memory / 1024).arg(s.paintTime, 0, 'f', 3);
+    };
+    QStringList lines;
+    lines << line(samples.first()) << line(samples.last());
+    lines << (failures.isEmpty() ? QString("PASS") : "FAIL: " + failures.join("; "));
+    return lines.join("\n");
+}
+
+/// 进程的常驻内存，不支持的系统返回0
+qint64 ChartSoak::residentBytes()
+{
+#if defined(Q_OS_LINUX)
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return 0;
+    while (!file.atEnd())
+    {
+        const QByteArray line = file.readLine();
+        if (line.startsWith("VmRSS:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+    }
+    return 0;
+#elif defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return qint64(counters.WorkingSetSize);
+#else
+    return 0;
+#endif
+}
+
+/// 和回放一样自己转发绘制事件，以得到每次绘制的耗时
+bool ChartSoak::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == chart && event->type() == QEvent::Paint && !painting)
+    {
+        painting = true;
+        QElapsedTimer timer;
+        timer.start();
+        QCoreApplication::sendEvent(chart, event);
+        paintTimes.append(timer.nsecsElapsed() / 1e6);
+        painting = false;
+        return true;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+/// 与示例中的“添加并移除”相同：每条线追加一个带标签的点，超出窗口后移除最早的
+void ChartSoak::feed()
+{
+    if (!chart)
+        return ;
+    ChartSeriesModel* model = chart->getModel();
+    for (int k = 0; k < pointsPerTick; k++)
+    {
+        x += 5;
+        for (int i = 0; i < options.lines && i < model->lineCount(); i++)
+        {
+            chart->addPoint(i, x, qrand() % 60 + 20, QString::number(x));
+            if (model->pointCount(i) > options.window)
+                chart->removeFirst(i);
+        }
+    }
+}
+
+void ChartSoak::sample()
+{
+    if (!chart)
+        return ;
+    SoakSample s;
+    s.time = clock.elapsed();
+    s.rss = residentBytes();
+    s.objects = qApp->findChildren<QObject*>().size();
+    for (QWidget* widget: QApplication::topLevelWidgets())
+        s.objects += 1 + widget->findChildren<QObject*>().size();
+    s.chart = chart->resourceStats();
+    s.paintTime = median(paintTimes);
+    paintTimes.clear();
+    samples.append(s);
+}
+
+/// 去掉开头10%的预热，比较之后最前与最后四分之一的采样
+void ChartSoak::analyze()
+{
+    const int warmup = qMax(samples.size() / 10, 1);
+    const int n = samples.size() - warmup;
+    if (n < 8)
+    {
+        failures << QString("too few samples (%1), run longer or sample more often").arg(samples.size());
+        return ;
+    }
+    const int quarter = n / 4;
+    auto average = [&](int from, double (*value)(const SoakSample&)) {
+        double sum = 0;
+        for (int i = from; i < from + quarter; i++)
+            sum += value(samples.at(i));
+        return sum / quarter;
+    };
+    auto peak = [&](int from, double (*value)(const SoakSample&)) {
+        double m = 0;
+        for (int i = from; i < from + quarter; i++)
+            m = qMax(m, value(samples.at(i)));
+        return m;
+    };
+    const int first = warmup, last = samples.size() - quarter;
+
+    // 数量类取峰值，应当完全不变；内存与耗时取平均，允许一定的波动
+    auto objects = [](const SoakSample& s) { return double(s.objects); };
+    auto animations = [](const SoakSample& s) { return double(s.chart.animations); };
+    auto labels = [](const SoakSample& s) { return double(s.chart.labels); };
+    auto points = [](const SoakSample& s) { return double(s.chart.points); };
+    auto memory = [](const SoakSample& s) { return double(s.chart.memory); };
+    auto rss = [](const SoakSample& s) { return double(s.rss); };
+    auto paint = [](const SoakSample& s) { return s.paintTime; };
+    checkGrowth("objects", peak(first, objects), peak(last, objects), 1.1, 10);
+    checkGrowth("animations", peak(first, animations), peak(last, animations), 1.1, 10);
+    checkGrowth("labels", peak(first, labels), peak(last, labels), 1.1, 10);
+    checkGrowth("points", peak(first, points), peak(last, points), 1.1, 10);
+    checkGrowth("chart memory", average(first, memory), average(last, memory), 1.25, 64 * 1024);
+    if (samples.first().rss > 0)
+        checkGrowth("rss", average(first, rss), average(last, rss), 1.25, 4 * 1024 * 1024);
+    checkGrowth("paint time", average(first, paint), average(last, paint), 2, 1);
+}
+
+/// 结束阶段超过开始阶段的 ratio 倍再加 slack，认为在持续增长
+void ChartSoak::checkGrowth(const QString &name, double first, double last, double ratio, double slack)
+{
+    if (last > first * ratio + slack)
+        failures << QString("%1 grew from %2 to %3").arg(name).arg(first, 0, 'f', 2).arg(last, 0, 'f', 2);
+}
@@ -0,0 +1,72 @@
+#ifndef CHARTSOAK_H
+#define CHARTSOAK_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QPointer>
+#include "linechart.h"
+
+/// 长时间运行测试的参数
+struct SoakOptions
+{
+    int lines = 4;                          // 折线数量
+    int rate = 100;                         // 每条线每秒追加的点数
+    int window = 500;                       // 每条线保留的点数，超出后移除最早的
+    int duration = 600;                     // 持续时间(s)
+    int sampleInterval = 1000;              // 采样间隔(ms)
+};
+
+/// 一次资源采样
+struct SoakSample
+{
+    qint64 time = 0;                        // 开始后经过的时间(ms)
+    qint64 rss = 0;                         // 进程常驻内存(bytes)，无法获取时为0
+    int objects = 0;                        // 应用程序与所有窗口之下存活的 QObject
+    ChartResourceStats chart;               // 折线图自身的资源
+    double paintTime = 0;                   // 采样间隔内每次绘制耗时的中位数(ms)
+};
+
+/**
+ * 长时间持续添加、移除数据（示例中“添加并移除”按钮的用法），定时采样资源占用
+ * 结束后比较开始与结束阶段：内存、对象、动画、标签、绘制耗时持续增长则认为不通过
+ * 可在无界面环境中运行（-platform offscreen）
+ */
+class ChartSoak : public QObject
+{
+    Q_OBJECT
+public:
+    ChartSoak(LineChart* chart, const SoakOptions& options, QObject* parent = nullptr);
+
+    bool run();
+    const QList<SoakSample>& getSamples() const;
+    const QStringList& getFailures() const;
+    QString toString() const;
+
+    static qint64 residentBytes();
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+    void feed();
+    void sample();
+    void analyze();
+    void checkGrowth(const QString& name, double first, double last, double ratio, double slack);
+
+private:
+    QPointer<LineChart> chart;
+    SoakOptions options;
+    QTimer feedTimer;
+    QTimer sampleTimer;
+    QElapsedTimer clock;
+    int x = 0;                              // 最近一个点的X
+    int pointsPerTick = 1;
+    bool painting = false;
+    QList<double> paintTimes;               // 本采样间隔内每次绘制的耗时(ms)
+    QList<SoakSample> samples;
+    QStringList failures;
+};
+
+#endif // CHARTSOAK_H
@@ -0,0 +1,226 @@
+#include "charttrace.h"
+#include <QSaveFile>
+#include <QtMath>
+#include <algorithm>
+
+void LatencyHistogram::add(qint64 us)
+{
+    us = qMax(us, qint64(0));
+    const int bucket = bucketOf(us);
+    if (buckets.size() <= bucket)
+        buckets.resize(bucket + 1);
+    buckets[bucket]++;
+    count++;
+    sum += us;
+    max = qMax(max, us);
+}
+
+/// 第 p(0~1) 分位数，返回所在桶的上界（不超过最大值）
+qint64 LatencyHistogram::percentile(double p) const
+{
+    if (!count)
+        return 0;
+    const qint64 rank = qMax(qint64(qCeil(qBound(0.0, p, 1.0) * count)), qint64(1));
+    qint64 seen = 0;
+    for (int i = 0; i < buckets.size(); i++)
+    {
+        seen += buckets.at(i);
+        if (seen >= rank)
+            return qMin(bucketUpper(i) - 1, max);
+    }
+    return max;
+}
+
+double LatencyHistogram::mean() const
+{
+    return count ? double(sum) / count : 0;
+}
+
+QString LatencyHistogram::toString() const
+{
+    return QString("samples %1, mean %2 ms, p50 %3 ms, p90 %4 ms, p99 %5 ms, max %6 ms, skipped %7")
+            .arg(count).arg(mean() / 1000, 0, 'f', 3)
+            .arg(percentile(0.5) / 1000.0, 0, 'f', 3).arg(percentile(0.9) / 1000.0, 0, 'f', 3)
+            .arg(percentile(0.99) / 1000.0, 0, 'f', 3).arg(max / 1000.0, 0, 'f', 3).arg(skipped);
+}
+
+/// 小于8us每微秒一个桶；之后 [2^e, 2^(e+1)) 均分为8个桶
+int LatencyHistogram::bucketOf(qint64 us)
+{
+    if (us < 8)
+        return int(us);
+    int e = 3;
+    while ((us >> (e + 1)) > 0)
+        e++;
+    const int sub = int(us >> (e - 3)) & 7;
+    return 8 + (e - 3) * 8 + sub;
+}
+
+/// 桶的上界（不含）
+qint64 LatencyHistogram::bucketUpper(int bucket)
+{
+    if (bucket < 8)
+        return bucket + 1;
+    const int e = (bucket - 8) / 8 + 3, sub = (bucket - 8) % 8;
+    return qint64(9 + sub) << (e - 3);
+}
+
+ChartTrace::ChartTrace(int capacity)
+{
+    ring.resize(qMax(capacity, 16));
+    clock.start();
+}
+
+/// 从创建开始经过的时间(us)
+qint64 ChartTrace::now() const
+{
+    return clock.nsecsElapsed() / 1000;
+}
+
+void ChartTrace::addSpan(const char *name, qint64 start, qint64 end)
+{
+    TraceEvent& e = ring[head];
+    e.name = name;
+    e.phase = 'X';
+    e.start = start;
+    e.duration = end - start;
+    e.value = 0;
+    head = (head + 1) % ring.size();
+    size = qMin(size + 1, ring.size());
+}
+
+void ChartTrace::addCounter(const char *name, qint64 value)
+{
+    TraceEvent& e = ring[head];
+    e.name = name;
+    e.phase = 'C';
+    e.start = now();
+    e.duration = 0;
+    e.value = value;
+    head = (head + 1) % ring.size();
+    size = qMin(size + 1, ring.size());
+}
+
+/// 缓冲区中现存的记录，从旧到新
+QList<TraceEvent> ChartTrace::events() const
+{
+    QList<TraceEvent> list;
+    list.reserve(size);
+    for (int i = 0; i < size; i++)
+        list.append(ring.at((head - size + i + ring.size()) % ring.size()));
+    return list;
+}
+
+/// Chrome trace 的 JSON 格式（Trace Event Format），时间单位为微秒
+QByteArray ChartTrace::toChromeJson() const
+{
+    QByteArray json;
+    json.reserve(size * 72 + 64);
+    json.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    const QList<TraceEvent> list = events();
+    for (int i = 0; i < list.size(); i++)
+    {
+        const TraceEvent& e = list.at(i);
+        if (i)
+            json.append(',');
+        json.append("\n{\"name\":\"").append(e.name).append("\",\"ph\":\"").append(e.phase)
+                .append("\",\"pid\":1,\"tid\":1,\"ts\":").append(QByteArray::number(e.start));
+        if (e.phase == 'X')
+            json.append(",\"dur\":").append(QByteArray::number(e.duration));
+        else
+            json.append(",\"args\":{\"value\":").append(QByteArray::number(e.value)).append('}');
+        json.append('}');
+    }
+    json.append("\n]}\n");
+    return json;
+}
+
+bool ChartTrace::exportChromeJson(const QString &path) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(toChromeJson());
+    return file.commit();
+}
+
+/// 清空记录与延迟统计
+void ChartTrace::clear()
+{
+    head = size = 0;
+    pending.clear();
+    latency = LatencyHistogram();
+}
+
+/// chart 的第 line 条折线添加了一个点，开始计算它的延迟
+void ChartTrace::sampleIngested(const void *chart, int line, int x)
+{
+    if (int(pending.size()) >= maxPending)
+    {
+        pending.pop_front();
+        latency.skipped++;
+    }
+    pending.push_back(Pending{chart, line, x, now()});
+}
+
+/// chart 的一次绘制完成，其中X在 [xFrom, xTo] 内的点已经显示到屏幕上，其他折线图的点不受影响
+/// 在可见范围左侧的点不再等待（已经滚动出去，计为 skipped），右侧的等待之后范围扩展
+void ChartTrace::samplesPainted(const void *chart, int xFrom, int xTo)
+{
+    if (pending.empty())
+        return ;
+    const qint64 end = now();
+    pending.erase(std::remove_if(pending.begin(), pending.end(), [&](const Pending& p) {
+        if (p.chart != chart)
+            return false;
+        if (p.x < xFrom)
+            latency.skipped++;
+        else if (p.x <= xTo)
+            latency.add(end - p.time);
+        else
+            return false;
+        return true;
+    }), pending.end());
+}
+
+/// 折线被移除：它的点不再等待，之后的折线下标前移
+void ChartTrace::lineRemoved(const void *chart, int line)
+{
+    pending.erase(std::remove_if(pending.begin(), pending.end(), [&](const Pending& p) {
+        return p.chart == chart && p.line == line;
+    }), pending.end());
+    for (Pending& p: pending)
+        if (p.chart == chart && p.line > line)
+            p.line--;
+}
+
+/// 折线图不再使用这个追踪（或被销毁）：它的点不再等待
+void ChartTrace::chartRemoved(const void *chart)
+{
+    pending.erase(std::remove_if(pending.begin(), pending.end(), [&](const Pending& p) {
+        return p.chart == chart;
+    }), pending.end());
+}
+
+int ChartTrace::pendingSamples() const
+{
+    return int(pending.size());
+}
+
+/// 每个点从添加到第一次绘制完成的延迟
+const LatencyHistogram &ChartTrace::getLatency() const
+{
+    return latency;
+}
+
+TraceSpan::TraceSpan(ChartTrace *trace, const char *name) : trace(trace), name(name)
+{
+    if (trace)
+        start = trace->now();
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (trace)
+        trace->addSpan(name, start, trace->now());
+}
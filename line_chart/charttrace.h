@@ -0,0 +1,99 @@
+#ifndef CHARTTRACE_H
+#define CHARTTRACE_H
+
+#include <QList>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QString>
+#include <deque>
+
+/// 一条追踪记录，对应 Chrome trace 格式中的一个事件
+struct TraceEvent
+{
+    const char* name = nullptr;             // 静态字符串，不复制
+    char phase = 'X';                       // 'X' 区间，'C' 计数器
+    qint64 start = 0;                       // 开始时间(us)
+    qint64 duration = 0;                    // 区间的时长(us)
+    qint64 value = 0;                       // 计数器的值
+};
+
+/**
+ * 延迟直方图(us)
+ * 每个2的幂区间再均分为8个桶，分位数的误差不超过 1/8
+ */
+struct LatencyHistogram
+{
+    QVector<qint64> buckets;
+    qint64 count = 0;
+    qint64 sum = 0;
+    qint64 max = 0;
+    qint64 skipped = 0;                     // 还没显示就已经离开可见范围的点
+
+    void add(qint64 us);
+    qint64 percentile(double p) const;
+    double mean() const;
+    QString toString() const;
+
+    static int bucketOf(qint64 us);
+    static qint64 bucketUpper(int bucket);
+};
+
+/**
+ * 折线图的性能追踪：区间与计数器记录在固定大小的环形缓冲区中（写满后覆盖最旧的）
+ * 可随时导出为 Chrome/Perfetto 的 trace JSON（chrome://tracing 或 ui.perfetto.dev 打开）
+ * 另外统计每个点从添加到第一次绘制到屏幕的延迟，按（折线图, 折线, X）区分
+ * 只在GUI线程中使用；不设置给折线图时没有任何开销
+ */
+class ChartTrace
+{
+public:
+    ChartTrace(int capacity = 65536);
+
+    qint64 now() const;
+    void addSpan(const char* name, qint64 start, qint64 end);
+    void addCounter(const char* name, qint64 value);
+    QList<TraceEvent> events() const;
+    QByteArray toChromeJson() const;
+    bool exportChromeJson(const QString& path) const;
+    void clear();
+
+    void sampleIngested(const void* chart, int line, int x);
+    void samplesPainted(const void* chart, int xFrom, int xTo);
+    void lineRemoved(const void* chart, int line);
+    void chartRemoved(const void* chart);
+    int pendingSamples() const;
+    const LatencyHistogram& getLatency() const;
+
+private:
+    struct Pending
+    {
+        const void* chart;                  // 多个折线图共用时只由所在的折线图绘制
+        int line;
+        int x;
+        qint64 time;                        // 添加的时间(us)
+    };
+
+    QElapsedTimer clock;
+    QVector<TraceEvent> ring;               // 环形缓冲区
+    int head = 0;                           // 下一条写入的位置
+    int size = 0;
+    std::deque<Pending> pending;            // 尚未绘制的点，按添加顺序
+    int maxPending = 65536;                 // 超出时最旧的计为 skipped
+    LatencyHistogram latency;
+};
+
+/// 在作用域内记录一个区间，trace 为空时什么都不做
+class TraceSpan
+{
+public:
+    TraceSpan(ChartTrace* trace, const char* name);
+    ~TraceSpan();
+
+private:
+    ChartTrace* trace;
+    const char* name;
+    qint64 start = 0;
+};
+
+#endif // CHARTTRACE_H
@@ -0,0 +1,410 @@
+#include "chunkstore.h"
+#include <QDir>
+#include <QRunnable>
+#include <QDebug>
+#include <algorithm>
+
+class ChunkLoadTask : public QRunnable
+{
+public:
+    ChunkLoadTask(ChunkStore* store, const QString& path, quint64 id, int segment, qint64 offset, int size)
+        : store(store), path(path), id(id), segment(segment), offset(offset), size(size)
+    {
+    }
+
+    void run() override
+    {
+        // 每次单独打开，不与GUI线程的写入共用文件句柄
+        QByteArray bytes;
+        QFile f(path);
+        if (f.open(QIODevice::ReadOnly) && f.seek(offset))
+            bytes = f.read(size);
+        ChunkStore* store = this->store;
+        quint64 id = this->id;
+        int segment = this->segment;
+        QMetaObject::invokeMethod(store, [=]{
+            store->finishLoad(id, segment, bytes);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    ChunkStore* store;
+    QString path;
+    quint64 id;
+    int segment;
+    qint64 offset;
+    int size;
+};
+
+/// 把一个块写入分段中预留的位置，每次单独打开，不与GUI线程共用文件句柄
+class ChunkWriteTask : public QRunnable
+{
+public:
+    ChunkWriteTask(ChunkStore* store, const QString& path, qint64 handle, int segment, qint64 offset, const QByteArray& bytes)
+        : store(store), path(path), handle(handle), segment(segment), offset(offset), bytes(bytes)
+    {
+    }
+
+    void run() override
+    {
+        QFile f(path);
+        bool ok = f.open(QIODevice::ReadWrite) && f.seek(offset) && f.write(bytes) == bytes.size();
+        f.close();
+        ChunkStore* store = this->store;
+        qint64 handle = this->handle;
+        int segment = this->segment;
+        QMetaObject::invokeMethod(store, [=]{
+            store->finishWrite(handle, segment, ok);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    ChunkStore* store;
+    QString path;
+    qint64 handle;
+    int segment;
+    qint64 offset;
+    QByteArray bytes;
+};
+
+/// 把稀疏分段中剩余的块依次复制到新的分段，只追加，不修改原来的文件
+class ChunkCompactTask : public QRunnable
+{
+public:
+    ChunkCompactTask(ChunkStore* store, int target, const QString& path, const QList<ChunkStore::ChunkMove>& moves)
+        : store(store), target(target), path(path), moves(moves)
+    {
+    }
+
+    void run() override
+    {
+        QList<qint64> offsets;
+        bool ok = true;
+        QFile out(path);
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Append))
+            ok = false;
+        QHash<QString, QSharedPointer<QFile>> inputs;
+        qint64 offset = 0;
+        for (int i = 0; i < moves.size() && ok; i++)
+        {
+            const ChunkStore::ChunkMove& move = moves.at(i);
+            QByteArray bytes = move.bytes;
+            if (bytes.isNull())
+            {
+                QSharedPointer<QFile>& in = inputs[move.path];
+                if (!in)
+                {
+                    in.reset(new QFile(move.path));
+                    in->open(QIODevice::ReadOnly);
+                }
+                if (in->isOpen() && in->seek(move.offset))
+                    bytes = in->read(move.size);
+            }
+            if (bytes.size() != move.size || out.write(bytes) != bytes.size())
+            {
+                ok = false;
+                break;
+            }
+            offsets.append(offset);
+            offset += bytes.size();
+        }
+        out.close();
+
+        ChunkStore* store = this->store;
+        int target = this->target;
+        QList<ChunkStore::ChunkMove> moves = this->moves;
+        QMetaObject::invokeMethod(store, [=]{
+            store->finishCompaction(target, moves, offsets, ok);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    ChunkStore* store;
+    int target;
+    QString path;
+    QList<ChunkStore::ChunkMove> moves;
+};
+
+/// 在其他线程中读取快照中的块，失败返回空
+QByteArray ChunkStoreView::read(qint64 handle) const
+{
+    auto bytes = pending.constFind(handle);
+    if (bytes != pending.constEnd())
+        return *bytes;
+    auto it = locations.constFind(handle);
+    if (it == locations.constEnd())
+        return QByteArray();
+    QSharedPointer<QFile>& file = files[it->segment];
+    if (!file)
+    {
+        file.reset(new QFile(paths.value(it->segment)));
+        file->open(QIODevice::ReadOnly);
+    }
+    if (!file->isOpen() || !file->seek(it->offset))
+        return QByteArray();
+    return file->read(it->size);
+}
+
+ChunkStore::ChunkStore(const QString &directory, QObject *parent)
+    : QObject(parent), directory(directory.isEmpty() ? QDir::tempPath() : directory), pins(new QAtomicInt(0))
+{
+    writing = openSegment();
+    pool.setMaxThreadCount(1);
+}
+
+ChunkStore::~ChunkStore()
+{
+    pool.waitForDone();
+    for (const Segment& segment: segments)
+        delete segment.file;
+}
+
+bool ChunkStore::isValid() const
+{
+    return writing >= 0;
+}
+
+/// 在当前分段末尾预留位置，写满后换一个新的分段；返回块的句柄，失败返回-1
+/// 在线程池中写入文件，不阻塞GUI线程；写入完成前（以及写入失败时）数据保留在内存中
+qint64 ChunkStore::write(const QByteArray &bytes)
+{
+    if (writing < 0)
+        return -1;
+    if (segments.value(writing).size > 0 && segments.value(writing).size + bytes.size() > SegmentSize)
+    {
+        int next = openSegment();
+        if (next < 0)
+            return -1;
+        segments[writing].sealed = true;
+        writing = next;
+    }
+
+    Segment& segment = segments[writing];
+    ChunkLocation location;
+    location.segment = writing;
+    location.offset = segment.size;
+    location.size = bytes.size();
+    segment.size += bytes.size();
+    segment.liveBytes += bytes.size();
+    segment.liveChunks++;
+    segment.writes++;
+    const qint64 handle = nextHandle++;
+    locations.insert(handle, location);
+    pending.insert(handle, bytes);
+    pool.start(new ChunkWriteTask(this, segment.file->fileName(), handle, writing, location.offset, bytes));
+    return handle;
+}
+
+/// 异步读取，完成后在GUI线程调用 done 并发出 chunkLoaded
+void ChunkStore::requestLoad(quint64 id, qint64 handle, std::function<void (const QByteArray &)> done)
+{
+    auto it = locations.constFind(handle);
+    if (loading.contains(id) || it == locations.constEnd())
+        return ;
+    Segment& segment = segments[it->segment];
+    segment.loads++;
+    loading.insert(id, done);
+    if (pending.contains(handle)) // 还没有写入文件，直接使用内存中的数据，同样在之后回到GUI线程
+    {
+        const QByteArray bytes = pending.value(handle);
+        const int segmentId = it->segment;
+        QMetaObject::invokeMethod(this, [=]{
+            finishLoad(id, segmentId, bytes);
+        }, Qt::QueuedConnection);
+        return ;
+    }
+    pool.start(new ChunkLoadTask(this, segment.file->fileName(), id, it->segment, it->offset, it->size));
+}
+
+bool ChunkStore::isLoading(quint64 id) const
+{
+    return loading.contains(id);
+}
+
+/// 某个块不再需要了；分段中的块全部释放后删除（或清空）文件，封存的分段变得稀疏时整理
+void ChunkStore::release(qint64 handle)
+{
+    auto it = locations.find(handle);
+    if (it == locations.end())
+        return ;
+    Segment& segment = segments[it->segment];
+    segment.liveChunks--;
+    segment.liveBytes -= it->size;
+    locations.erase(it);
+    pending.remove(handle);
+
+    if (segment.sealed && !segment.compacting && segment.liveChunks > 0 && segment.liveBytes * 2 < segment.size)
+        startCompaction();
+    collectGarbage();
+}
+
+/// 给快照使用的只读视图，持有期间不删除文件
+ChunkStoreView ChunkStore::view() const
+{
+    ChunkStoreView view;
+    view.pin.reset(new ChunkStorePin(pins));
+    view.locations = locations;
+    view.pending = pending;
+    for (auto it = segments.constBegin(); it != segments.constEnd(); it++)
+        view.paths.insert(it.key(), it->file->fileName());
+    return view;
+}
+
+/// 所有分段文件的大小
+qint64 ChunkStore::fileSize() const
+{
+    qint64 size = 0;
+    for (const Segment& segment: segments)
+        size += segment.size;
+    return size;
+}
+
+int ChunkStore::segmentCount() const
+{
+    return segments.size();
+}
+
+/// 新建一个分段文件，返回编号，失败返回-1
+int ChunkStore::openSegment()
+{
+    QTemporaryFile* file = new QTemporaryFile(QDir(directory).filePath("linechart_XXXXXX.chunks"));
+    if (!file->open())
+    {
+        qWarning() << "无法创建分页文件：" << file->fileTemplate();
+        delete file;
+        return -1;
+    }
+    Segment segment;
+    segment.file = file;
+    segments.insert(nextSegment, segment);
+    return nextSegment++;
+}
+
+/// 写入完成后释放内存中的数据；失败时保留在内存中，之后的读取仍然有效
+void ChunkStore::finishWrite(qint64 handle, int segment, bool ok)
+{
+    if (segments.contains(segment))
+        segments[segment].writes--;
+    if (ok)
+        pending.remove(handle);
+    else if (pending.contains(handle))
+        qWarning() << "写入分页文件失败，块保留在内存中，分段：" << segment;
+    collectGarbage();
+}
+
+void ChunkStore::finishLoad(quint64 id, int segment, const QByteArray &bytes)
+{
+    if (segments.contains(segment))
+        segments[segment].loads--;
+    auto done = loading.take(id);
+    if (done && !bytes.isEmpty())
+        done(bytes);
+    emit chunkLoaded(id);
+    collectGarbage();
+}
+
+/// 把所有稀疏的封存分段中剩余的块复制到一个新的分段，完成后在GUI线程更新位置
+void ChunkStore::startCompaction()
+{
+    if (compacting)
+        return ;
+    QList<int> sources;
+    for (auto it = segments.constBegin(); it != segments.constEnd(); it++)
+        if (it->sealed && !it->compacting && it->liveChunks > 0 && it->liveBytes * 2 < it->size)
+            sources.append(it.key());
+    if (sources.isEmpty())
+        return ;
+    int target = openSegment();
+    if (target < 0)
+        return ;
+
+    QList<ChunkMove> moves;
+    for (auto it = locations.constBegin(); it != locations.constEnd(); it++)
+    {
+        if (!sources.contains(it->segment))
+            continue;
+        ChunkMove move;
+        move.handle = it.key();
+        move.segment = it->segment;
+        move.path = segments.value(it->segment).file->fileName();
+        move.offset = it->offset;
+        move.size = it->size;
+        move.bytes = pending.value(it.key());
+        moves.append(move);
+    }
+    // 按原来的位置顺序读取
+    std::sort(moves.begin(), moves.end(), [](const ChunkMove& a, const ChunkMove& b) {
+        return a.segment != b.segment ? a.segment < b.segment : a.offset < b.offset;
+    });
+    for (int s: sources)
+        segments[s].compacting = true;
+    segments[target].compacting = true;
+    segments[target].sealed = true;
+    compacting = true;
+    pool.start(new ChunkCompactTask(this, target, segments.value(target).file->fileName(), moves));
+}
+
+/// 整理完成：期间没有被释放的块改为新的位置；来源分段中的块都移走后由 collectGarbage 删除
+void ChunkStore::finishCompaction(int target, const QList<ChunkMove> &moves, const QList<qint64> &offsets, bool ok)
+{
+    compacting = false;
+    for (const ChunkMove& move: moves)
+        if (segments.contains(move.segment))
+            segments[move.segment].compacting = false;
+    Segment& out = segments[target];
+    out.compacting = false;
+    if (!ok)
+    {
+        qWarning() << "整理分页文件失败：" << out.file->fileName();
+        collectGarbage();
+        return ;
+    }
+
+    for (int i = 0; i < moves.size(); i++)
+    {
+        const ChunkMove& move = moves.at(i);
+        auto it = locations.find(move.handle);
+        if (it == locations.end() || it->segment != move.segment)
+            continue;
+        Segment& source = segments[move.segment];
+        source.liveChunks--;
+        source.liveBytes -= move.size;
+        it->segment = target;
+        it->offset = offsets.at(i);
+        out.liveChunks++;
+        out.liveBytes += move.size;
+        if (!move.bytes.isNull()) // 已经写入新的分段
+            pending.remove(move.handle);
+    }
+    if (!moves.isEmpty())
+        out.size = offsets.last() + moves.last().size;
+    collectGarbage();
+}
+
+/// 删除没有任何块的分段：存在视图、正在读写或整理时暂缓，之后释放或读写完成时再检查
+/// 正在追加的分段只清空
+void ChunkStore::collectGarbage()
+{
+    if (pins->loadAcquire() > 0)
+        return ;
+    for (auto it = segments.begin(); it != segments.end(); )
+    {
+        Segment& segment = it.value();
+        if (segment.liveChunks > 0 || segment.loads > 0 || segment.writes > 0 || segment.compacting)
+        {
+            it++;
+            continue;
+        }
+        if (it.key() == writing)
+        {
+            if (segment.size > 0)
+                segment.file->resize(0);
+            segment.size = 0;
+            segment.liveBytes = 0;
+            it++;
+            continue;
+        }
+        delete segment.file;
+        it = segments.erase(it);
+    }
+}
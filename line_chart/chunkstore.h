@@ -0,0 +1,133 @@
+#ifndef CHUNKSTORE_H
+#define CHUNKSTORE_H
+
+#include <QObject>
+#include <QTemporaryFile>
+#include <QThreadPool>
+#include <QHash>
+#include <QFile>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <functional>
+
+/// 一个换出的块在分段文件中的位置
+struct ChunkLocation
+{
+    int segment = -1;
+    qint64 offset = 0;
+    int size = 0;
+};
+
+/// 存在期间 ChunkStore 不删除任何分段文件，快照中拷贝的位置一直有效
+/// 可在其他线程中析构
+class ChunkStorePin
+{
+public:
+    explicit ChunkStorePin(const QSharedPointer<QAtomicInt>& pins) : pins(pins)
+    {
+        pins->ref();
+    }
+
+    ~ChunkStorePin()
+    {
+        pins->deref();
+    }
+
+private:
+    QSharedPointer<QAtomicInt> pins;
+};
+
+/**
+ * 快照使用的只读视图：拷贝了所有块的位置与尚未写入文件的块（写时复制，只是增加引用计数）
+ * 持有期间文件不会被删除，整理只写入新的分段，不改写已有的内容，可在其他线程中读取
+ */
+class ChunkStoreView
+{
+    friend class ChunkStore;
+public:
+    QByteArray read(qint64 handle) const;
+
+private:
+    QHash<qint64, ChunkLocation> locations;
+    QHash<qint64, QByteArray> pending;      // 尚未写入文件的块
+    QHash<int, QString> paths;              // 分段编号 → 文件路径
+    QSharedPointer<ChunkStorePin> pin;
+    mutable QHash<int, QSharedPointer<QFile>> files; // 读取时按需打开
+};
+
+/**
+ * 压缩块的磁盘存储：由多个分段临时文件组成，每个分段写满后封存
+ * 写入时在GUI线程中预留位置并立即返回句柄，在线程池中追加到当前分段，完成前数据保留在内存中
+ * 读取同样在线程池中异步完成，结果回到GUI线程；线程池只有一个线程，按提交的先后执行
+ * 分段中的块全部释放后删除文件；封存的分段有用的部分不到一半时，在后台把剩余的块整理到新的分段
+ */
+class ChunkStore : public QObject
+{
+    Q_OBJECT
+    friend class ChunkLoadTask;
+    friend class ChunkWriteTask;
+    friend class ChunkCompactTask;
+public:
+    ChunkStore(const QString& directory = QString(), QObject *parent = nullptr);
+    ~ChunkStore() override;
+
+    bool isValid() const;
+    qint64 write(const QByteArray& bytes);
+    void requestLoad(quint64 id, qint64 handle, std::function<void(const QByteArray&)> done);
+    bool isLoading(quint64 id) const;
+    void release(qint64 handle);
+    ChunkStoreView view() const;
+    qint64 fileSize() const;
+    int segmentCount() const;
+
+signals:
+    void chunkLoaded(quint64 id);
+
+private:
+    struct Segment
+    {
+        QTemporaryFile* file = nullptr;
+        qint64 size = 0;                    // 文件大小
+        qint64 liveBytes = 0;               // 仍然有用的块的大小
+        int liveChunks = 0;
+        int loads = 0;                      // 正在读取的次数
+        int writes = 0;                     // 正在写入的次数
+        bool sealed = false;                // 写满后不再追加
+        bool compacting = false;            // 正在整理（作为来源或目标）
+    };
+
+    /// 整理时移动的一个块
+    struct ChunkMove
+    {
+        qint64 handle = 0;
+        int segment = -1;
+        QString path;
+        qint64 offset = 0;
+        int size = 0;
+        QByteArray bytes;                   // 尚未写入文件的块直接使用内存中的数据
+    };
+
+    int openSegment();
+    void finishLoad(quint64 id, int segment, const QByteArray& bytes);
+    void finishWrite(qint64 handle, int segment, bool ok);
+    void startCompaction();
+    void finishCompaction(int target, const QList<ChunkMove>& moves, const QList<qint64>& offsets, bool ok);
+    void collectGarbage();
+
+private:
+    static const qint64 SegmentSize = 4 << 20; // 分段写满的大小
+
+    QString directory;
+    QHash<int, Segment> segments;
+    int writing = -1;                       // 正在追加的分段
+    int nextSegment = 0;
+    QHash<qint64, ChunkLocation> locations; // 句柄 → 位置，整理后更新
+    QHash<qint64, QByteArray> pending;      // 尚未写入文件（或写入失败）的块，读取时直接使用
+    qint64 nextHandle = 0;
+    QThreadPool pool;                       // 写入、读取与整理文件的线程，析构时等待全部完成
+    QHash<quint64, std::function<void(const QByteArray&)>> loading; // 正在读取的块
+    bool compacting = false;                // 同时只有一次整理
+    QSharedPointer<QAtomicInt> pins;        // 存在的视图数量，不为0时不删除文件
+};
+
+#endif // CHUNKSTORE_H
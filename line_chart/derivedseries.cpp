@@ -0,0 +1,152 @@
+#include "derivedseries.h"
+#include <QtMath>
+
+/// 设置派生的类型与窗口，并清空已有的状态
+void DerivedSeries::configure(Type type, int window, bool spanX)
+{
+    this->type = type;
+    this->window = qMax(window, 1);
+    this->spanX = spanX;
+    clear();
+}
+
+DerivedSeries::Type DerivedSeries::getType() const
+{
+    return type;
+}
+
+int DerivedSeries::getWindow() const
+{
+    return window;
+}
+
+bool DerivedSeries::isSpanX() const
+{
+    return spanX;
+}
+
+/// 源数据追加了一个点，返回对应的派生值
+int DerivedSeries::push(const QPoint &p)
+{
+    Entry e{nextSeq++, p.x(), p.y()};
+    switch (type)
+    {
+    case ExponentialAverage:
+    {
+        if (e.seq == 0)
+        {
+            ema = e.y;
+        }
+        else
+        {
+            double alpha = spanX ? 1 - qExp(-double(e.x - emaX) / window) : 2.0 / (window + 1);
+            ema += alpha * (e.y - ema);
+        }
+        emaX = e.x;
+        return qRound(ema);
+    }
+    case RollingMin:
+    case RollingMax:
+    {
+        // 被新点“压住”的旧点不可能再成为最值
+        while (!extremes.empty() && (type == RollingMin ? extremes.back().y >= e.y : extremes.back().y <= e.y))
+            extremes.pop_back();
+        extremes.push_back(e);
+        expire(e);
+        return extremes.front().y;
+    }
+    case MovingAverage:
+    case RollingStdDev:
+    {
+        entries.push_back(e);
+        sum += e.y;
+        sumSquares += double(e.y) * e.y;
+        expire(e);
+        const int n = int(entries.size());
+        const double mean = double(sum) / n;
+        if (type == MovingAverage)
+            return qRound(mean);
+        return qRound(qSqrt(qMax(sumSquares / n - mean * mean, 0.0)));
+    }
+    default:
+        return e.y;
+    }
+}
+
+/// 源数据移除了最早的点：如果还在窗口里，就从窗口中去掉
+void DerivedSeries::evictFirst()
+{
+    if (!entries.empty() && entries.front().seq == firstSeq)
+        popFront();
+    if (!extremes.empty() && extremes.front().seq == firstSeq)
+        extremes.pop_front();
+    firstSeq++;
+}
+
+void DerivedSeries::clear()
+{
+    entries.clear();
+    extremes.clear();
+    sum = 0;
+    sumSquares = 0;
+    ema = 0;
+    emaX = 0;
+    nextSeq = firstSeq = 0;
+}
+
+void DerivedSeries::save(QDataStream &out) const
+{
+    out << qint32(type) << window << spanX << sum << sumSquares << ema << emaX << nextSeq << firstSeq;
+    for (const std::deque<Entry>* queue: { &entries, &extremes })
+    {
+        out << quint32(queue->size());
+        for (const Entry& e: *queue)
+            out << e.seq << e.x << e.y;
+    }
+}
+
+bool DerivedSeries::load(QDataStream &in)
+{
+    clear();
+    qint32 t = 0;
+    in >> t >> window >> spanX >> sum >> sumSquares >> ema >> emaX >> nextSeq >> firstSeq;
+    type = Type(t);
+    for (std::deque<Entry>* queue: { &entries, &extremes })
+    {
+        quint32 count = 0;
+        in >> count;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+        {
+            Entry e;
+            in >> e.seq >> e.x >> e.y;
+            queue->push_back(e);
+        }
+    }
+    if (in.status() != QDataStream::Ok || type < None || type > RollingStdDev || window < 1)
+    {
+        type = None;
+        clear();
+        return false;
+    }
+    return true;
+}
+
+/// 去掉窗口外的点：按点数时为 seq <= 最新 - window，按X跨度时为 x <= 最新 - window
+void DerivedSeries::expire(const Entry &latest)
+{
+    auto expired = [&](const Entry& e) {
+        return spanX ? qint64(e.x) <= qint64(latest.x) - window : e.seq <= latest.seq - window;
+    };
+    while (!entries.empty() && expired(entries.front()))
+        popFront();
+    while (!extremes.empty() && expired(extremes.front()))
+        extremes.pop_front();
+}
+
+void DerivedSeries::popFront()
+{
+    const Entry& e = entries.front();
+    sum -= e.y;
+    sumSquares -= double(e.y) * e.y;
+    entries.pop_front();
+}
@@ -0,0 +1,63 @@
+#ifndef DERIVEDSERIES_H
+#define DERIVEDSERIES_H
+
+#include <QPoint>
+#include <QDataStream>
+#include <deque>
+
+/**
+ * 派生折线（移动平均、指数平均、滚动最值、滚动标准差）的增量计算状态
+ * 窗口为最近 N 个点，或者最近 X 跨度内的点
+ * 每追加或移除一个源数据点都是均摊 O(1)：和与平方和随窗口增减，最值使用单调队列
+ */
+class DerivedSeries
+{
+public:
+    enum Type
+    {
+        None,
+        MovingAverage,                      // 简单移动平均
+        ExponentialAverage,                 // 指数移动平均，alpha = 2/(N+1)；按X跨度时为 1-exp(-dx/span)
+        RollingMin,
+        RollingMax,
+        RollingStdDev                       // 总体标准差
+    };
+
+    void configure(Type type, int window, bool spanX);
+    Type getType() const;
+    int getWindow() const;
+    bool isSpanX() const;
+
+    int push(const QPoint& p);
+    void evictFirst();
+    void clear();
+
+    void save(QDataStream& out) const;
+    bool load(QDataStream& in);
+
+private:
+    struct Entry
+    {
+        qint64 seq;                         // 源数据中的序号
+        int x;
+        int y;
+    };
+
+    void expire(const Entry& latest);
+    void popFront();
+
+private:
+    Type type = None;
+    int window = 1;                         // 点数，或者X跨度
+    bool spanX = false;                     // 窗口按X跨度而不是点数
+    std::deque<Entry> entries;              // 窗口内的点（平均与标准差）
+    std::deque<Entry> extremes;             // 单调队列（最小值递增，最大值递减）
+    qint64 sum = 0;
+    double sumSquares = 0;
+    double ema = 0;
+    int emaX = 0;                           // 上一次更新EMA的X
+    qint64 nextSeq = 0;                     // 下一个源数据点的序号
+    qint64 firstSeq = 0;                    // 源数据中现存的第一个点的序号
+};
+
+#endif // DERIVEDSERIES_H
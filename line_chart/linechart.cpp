@@ -1,39 +1,188 @@
 #include "linechart.h"
+#include "chartframeclock.h"
 #include <QDebug>
 #include <QApplication>
 #include <QLinearGradient>
+#include <QMetaMethod>
+#include <QElapsedTimer>
+#include <QBuffer>
+#include <QSaveFile>
+#include <QRunnable>
+
+namespace
+{
+const quint32 SnapshotMagic = 0x4C43534E;   // "LCSN"
+const quint32 SnapshotVersion = 3;
+
+/// 写入快照：文件头、折线图设置、模型数据
+bool writeSnapshotData(QIODevice* device, const QByteArray& settings, const SeriesSnapshot& snapshot)
+{
+    QDataStream out(device);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << SnapshotMagic << SnapshotVersion << quint8(QSysInfo::ByteOrder) << settings;
+    return ChartSeriesModel::writeSnapshot(out, snapshot);
+}
+
+/// 在后台线程中写入快照文件，写完后回到GUI线程通知
+class SnapshotWriteTask : public QRunnable
+{
+public:
+    SnapshotWriteTask(QObject* chart, const QString& path, const QByteArray& settings, const SeriesSnapshot& snapshot)
+        : chart(chart), path(path), settings(settings), snapshot(snapshot)
+    {
+    }
+
+    void run() override
+    {
+        QSaveFile file(path);
+        bool ok = file.open(QIODevice::WriteOnly)
+                && writeSnapshotData(&file, settings, snapshot)
+                && file.commit();
+        QMetaObject::invokeMethod(chart, "onSnapshotWritten", Qt::QueuedConnection,
+                                  Q_ARG(QString, path), Q_ARG(bool, ok));
+    }
+
+private:
+    QObject* chart;
+    QString path;
+    QByteArray settings;
+    SeriesSnapshot snapshot;
+};
+}
+
+/// 按最近一帧的大小估算
+qint64 PaintScratch::memoryBytes() const
+{
+    return (points.size() + displayPoints.size() + missing.size()) * qint64(sizeof(void*))
+            + controlPoints.capacity() * qint64(sizeof(Vector2D))
+            + (path.elementCount() + dotPath.elementCount()) * qint64(sizeof(QPainterPath::Element))
+            + text.capacity() * qint64(sizeof(QChar));
+}
+
+qint64 ChartMemoryReport::total() const
+{
+    qint64 bytes = xLabels + plotCache + rasterBuffer + scratch;
+    for (const SeriesMemory& memory: series)
+        bytes += memory.total();
+    return bytes;
+}
 
 LineChart::LineChart(QWidget *parent) : QWidget(parent)
 {
     setMouseTracking(true);
+    setModel(new ChartSeriesModel(this));
+
+    refineTimer.setSingleShot(true);
+    refineTimer.setInterval(0);
+    connect(&refineTimer, &QTimer::timeout, this, &LineChart::refinePlotCache);
+
+    snapshotPool.setMaxThreadCount(1);
+    connect(&snapshotTimer, &QTimer::timeout, this, [=]{
+        saveSnapshotAsync(snapshotPath);
+    });
+}
+
+LineChart::~LineChart()
+{
+    if (useFrameClock)
+        ChartFrameClock::instance()->unregisterChart(this);
+    if (trace)
+        trace->chartRemoved(this);
+    snapshotPool.waitForDone();
 }
 
 int LineChart::lineCount() const
 {
-    return datas.size();
+    return model->lineCount();
+}
+
+/// 使用另一个数据模型（可被多个折线图共享），默认使用自己创建的模型
+void LineChart::setModel(ChartSeriesModel *model)
+{
+    Q_ASSERT(model);
+    if (this->model == model)
+        return ;
+    if (this->model)
+    {
+        disconnect(this->model, nullptr, this, nullptr);
+        if (this->model->parent() == this)
+            this->model->deleteLater();
+    }
+    this->model = model;
+    connect(model, &ChartSeriesModel::lineAdded, this, &LineChart::onLineAdded);
+    connect(model, &ChartSeriesModel::lineRemoved, this, &LineChart::onLineRemoved);
+    connect(model, &ChartSeriesModel::pointsAppended, this, &LineChart::onPointsAppended);
+    connect(model, &ChartSeriesModel::pointsEvicted, this, &LineChart::onPointsEvicted);
+    connect(model, &ChartSeriesModel::pointsChanged, this, &LineChart::onPointsChanged);
+    connect(model, &ChartSeriesModel::pointsRolledUp, this, &LineChart::onPointsRolledUp);
+    connect(model, &ChartSeriesModel::xRangeLinked, this, &LineChart::onXRangeLinked);
+    connect(model, &ChartSeriesModel::xLabelsChanged, this, &LineChart::onXLabelsChanged);
+    connect(model, &ChartSeriesModel::historyLoaded, this, &LineChart::onHistoryLoaded);
+    connect(model, &ChartSeriesModel::modelReset, this, &LineChart::onModelReset);
+
+    fitDisplayRangeToData();
+    plotCacheValid = false;
+    update();
+}
+
+/// 根据已有的数据重新确定显示范围
+void LineChart::fitDisplayRangeToData()
+{
+    bool found = false;
+    for (int i = 0; i < model->lineCount(); i++)
+    {
+        const ChartData& line = model->line(i);
+        int xMin = 0;
+        if (!model->headX(i, 0, xMin))
+            continue;
+        const int hot = model->hotCount(i);
+        int xMax = hot ? model->hotPoint(i, hot - 1).x() : line.history.lastX();
+        RangeStatistics stat = model->statistics(i, xMin, xMax);
+        int yMin = stat.min, yMax = stat.max;
+        displayXMin = found ? qMin(displayXMin, xMin) : xMin;
+        displayXMax = found ? qMax(displayXMax, xMax) : xMax;
+        displayYMin = found ? qMin(displayYMin, yMin) : yMin;
+        displayYMax = found ? qMax(displayYMax, yMax) : yMax;
+        found = true;
+    }
+}
+
+ChartSeriesModel *LineChart::getModel() const
+{
+    return model;
+}
+
+/// 缩放、平移时同步修改共享同一模型、且同样开启了同步的折线图
+void LineChart::setLinkXRange(bool link)
+{
+    this->linkXRange = link;
 }
 
 void LineChart::setPointLineType(int t)
 {
     this->pointLineType = t;
+    plotCacheValid = false;
     update();
 }
 
 void LineChart::setPointValueType(int t)
 {
     this->pointValueType = t;
+    plotCacheValid = false;
     update();
 }
 
 void LineChart::setPointDotType(int t)
 {
     this->pointDotType = t;
+    plotCacheValid = false;
     update();
 }
 
 void LineChart::setPointDotRadius(int r)
 {
     this->pointDotRadius = r;
+    plotCacheValid = false;
     update();
 }
 
@@ -42,40 +191,157 @@ void LineChart::setLabelSpacing(int s)
     this->labelSpacing = s;
 }
 
-void LineChart::addLine(ChartData data)
+/// 开启后，每次X显示范围改变都会让Y轴贴合可见数值
+void LineChart::setAutoFitY(bool fit, double padding)
 {
-    saveRange();
-    // 检查数据有效性
-    if (!data.points.empty())
+    this->autoFitY = fit;
+    this->autoFitPadding = padding;
+    if (fit)
     {
-        QPoint first = data.points.first();
-        if (data.xMin == data.xMax)
-        {
-            data.xMin = data.xMax = first.x();
-            for (QPoint p: data.points)
-            {
-                if (data.xMin > p.x())
-                    data.xMin = p.x();
-                else if (data.xMax < p.x())
-                    data.xMax = p.x();
-            }
-        }
-        if (data.yMin == data.yMax)
-        {
-            data.yMin = data.yMax = first.y();
-            for (QPoint p: data.points)
-            {
-                if (data.yMin > p.y())
-                    data.yMin = p.y();
-                else if (data.yMax < p.y())
-                    data.yMax = p.y();
-            }
-        }
+        saveRange();
+        startRangeAnimation();
+    }
+}
+
+/// 直线连线（pointLineType=1）在可见范围内要画的段数超过该值时绕过 QPainterPath 直接光栅化
+void LineChart::setRasterLineThreshold(int segments)
+{
+    this->rasterLineThreshold = segments;
+    plotCacheValid = false;
+    update();
+}
+
+/// 开启后（默认关闭），在动画或拖拽期间，若完整画质重绘整个线条层的耗时超过阈值（毫秒），
+/// 则临时关闭抗锯齿、曲线、圆点与数值，并按像素列抽稀，停止交互后恢复
+void LineChart::setAdaptiveQuality(bool enable, int thresholdMs)
+{
+    this->adaptiveQuality = enable;
+    this->qualityThreshold = thresholdMs;
+    plotCacheValid = false;
+    update();
+}
+
+/// 是否正在交互：范围动画中或鼠标拖动中（只是按下、没有超过拖动距离的不算）
+bool LineChart::isInteracting() const
+{
+    return animatingXMin || animatingXMax || animatingYMin || animatingYMax || selecting;
+}
+
+/// 横向平移时复用上一帧的线条图像，只绘制新露出的部分
+void LineChart::setScrollBlit(bool enable)
+{
+    this->enableScrollBlit = enable;
+    plotCacheValid = false;
+    update();
+}
+
+/// 渐进绘制：完整绘制一帧超过 sliceMs 时，先立即画出抽稀后的粗略图像，
+/// 再每次事件循环细化一段（每段约 sliceMs），期间鼠标等事件照常处理
+/// 细化途中范围、数据或大小改变，则放弃剩余部分并重新开始
+void LineChart::setProgressiveRender(bool enable, int sliceMs)
+{
+    this->progressiveRender = enable;
+    this->progressiveSlice = qMax(sliceMs, 1);
+    plotCacheValid = false;
+    update();
+}
+
+/// 记录添加数据、范围动画、绘制各阶段的耗时，以及每个点从添加到显示的延迟
+/// 多个折线图可以共用同一个；不持有，为空时关闭
+void LineChart::setTrace(ChartTrace *trace)
+{
+    if (this->trace && this->trace != trace)
+        this->trace->chartRemoved(this);
+    this->trace = trace;
+}
+
+ChartTrace *LineChart::getTrace() const
+{
+    return trace;
+}
+
+/// 使用进程内共享的帧时钟：排队的数据与重绘和其他折线图在同一帧中处理
+/// 适合同时显示大量折线图；不可见时不绘制，重绘耗时较多时可能推迟到下一帧
+/// 动画也由帧时钟推进需另外开启 ChartFrameClock::setDriveAnimations（影响整个程序的属性动画）
+void LineChart::setFrameClock(bool enable)
+{
+    if (useFrameClock == enable)
+        return ;
+    useFrameClock = enable;
+    if (enable)
+    {
+        ChartFrameClock::instance()->registerChart(this);
     }
-    Q_ASSERT(data.xLabels.empty() || data.xLabels.size() == data.points.size());
+    else
+    {
+        ChartFrameClock::instance()->unregisterChart(this);
+        if (framePending)
+            presentFrame();
+    }
+}
+
+void LineChart::addLine(ChartData data)
+{
+    model->addLine(std::move(data));
+}
+
+void LineChart::removeLine(int index)
+{
+    model->removeLine(index);
+}
+
+void LineChart::addPoint(int index, int x, int y)
+{
+    model->addPoint(index, x, y);
+}
+
+void LineChart::addPoint(int index, int x, int y, const QString &label)
+{
+    model->addPoint(index, x, y, label);
+}
+
+/// 把点放入队列，稍后在GUI线程中批量加入模型；可在采集线程中调用
+/// 使用帧时钟时每帧取出一次，否则在下一次事件循环中取出
+void LineChart::queuePoint(int index, int x, int y)
+{
+    QMutexLocker locker(&queueMutex);
+    queuedPoints.append(qMakePair(index, QPoint(x, y)));
+    if (drainScheduled)
+        return ;
+    drainScheduled = true;
+    QMetaObject::invokeMethod(this, "onPointsQueued", Qt::QueuedConnection);
+}
+
+void LineChart::removeFirst(int index)
+{
+    model->removeFirst(index);
+}
+
+/// 直接显示调用者持有的X/Y数组，不复制；生命周期与修改通知见 ChartSeriesModel::attachSeries
+int LineChart::attachSeries(const int *xs, const int *ys, int count, QColor color, const QString &title)
+{
+    return model->attachSeries(xs, ys, count, color, title);
+}
+
+/// 接管调用者移交的X/Y数组，不复制
+int LineChart::adoptSeries(QVector<int> &&xs, QVector<int> &&ys, QColor color, const QString &title)
+{
+    return model->adoptSeries(std::move(xs), std::move(ys), color, title);
+}
+
+/// 添加派生自 source 的折线（移动平均、滚动最值等），随源数据增量更新
+int LineChart::addDerivedLine(int source, DerivedSeries::Type type, int window, bool spanX, QColor color, const QString &title)
+{
+    return model->addDerivedLine(source, type, window, spanX, color, title);
+}
+
+void LineChart::onLineAdded(int index)
+{
+    saveRange();
+    const ChartData& data = model->line(index);
 
     // 新增的数据对当前视图的影响
-    if (datas.empty()) // 第一次传入数据
+    if (model->lineCount() == 1) // 第一次传入数据
     {
         displayXMin = data.xMin;
         displayXMax = data.xMax;
@@ -91,112 +357,245 @@ void LineChart::addLine(ChartData data)
         displayYMax = qMax(displayYMax, data.yMax);
     }
 
-    // 新的label集合插入到现有X轴label中（多条数据融合）
-    int index = 0;
-    for (int i = 0; i < data.xLabels.size(); i++)
+    plotCacheValid = false;
+    startRangeAnimation();
+}
+
+void LineChart::onLineRemoved(int index)
+{
+    if (trace)
+        trace->lineRemoved(this, index);
+    plotCacheValid = false;
+    requestFrame();
+}
+
+/// 新添加的点：只有源数据（不含派生折线）计入显示延迟
+void LineChart::onPointsAppended(int index, int first, int count)
+{
+    TraceSpan span(trace, "ingest");
+    if (trace && model->line(index).derivedSource < 0)
+        for (int i = first; i < first + count; i++)
+            trace->sampleIngested(this, index, model->hotPoint(index, i).x());
+    updateForPoints(index, first, count);
+}
+
+/// 点 [first, first + count) 新增或变化后：扩展显示范围，范围不变时只重绘缓存中受影响的竖条
+void LineChart::updateForPoints(int index, int first, int count)
+{
+    saveRange();
+    for (int i = first; i < first + count; i++)
+    {
+        const QPoint pt = model->hotPoint(index, i);
+        displayXMin = qMin(displayXMin, pt.x());
+        displayXMax = qMax(displayXMax, pt.x());
+        displayYMin = qMin(displayYMin, pt.y());
+        displayYMax = qMax(displayYMax, pt.y());
+    }
+    if (autoFitY)
+        fitVisibleYRange();
+
+    // 显示范围不变：只在缓存上重绘新增点影响的竖条
+    if (displayXMin == _savedXMin && displayXMax == _savedXMax
+            && displayYMin == _savedYMin && displayYMax == _savedYMax
+            && plotCacheMatchesDisplay())
     {
-        int x = data.points.at(i).x();
-        const QString& label = data.xLabels.at(i);
-        while (index < xLabels.size() && xLabelPoss.at(index) < x)
-            index++;
-        if (index >= xLabels.size()) // x超出范围了
-        {
-            xLabels.append(label);
-            xLabelPoss.append(x);
-        }
-        else if (xLabelPoss.at(index) == x) // 一样的x，新的label，跳过
-        {
-            continue;
-        }
-        else if (xLabelPoss.at(index) > x)
-        {
-            xLabels.insert(index, label);
-            xLabelPoss.insert(index, x);
-        }
-        else
+        QRect dirty = appendedPlotRect(index, first, count);
+        if (!dirty.isEmpty())
         {
-            qWarning() << data.points;
-            qWarning() << data.xLabels;
-            qWarning() << this->xLabels;
-            qWarning() << this->xLabelPoss;
-            qWarning() << index << x;
-            Q_ASSERT(false);
+            plotDirty |= dirty;
+            requestFrame(dirty.translated(contentRect.topLeft()));
         }
+        return ;
     }
 
-    datas.append(data);
-
+    plotCacheValid = false;
     startRangeAnimation();
 }
 
-void LineChart::removeLine(int index)
+/// 点被原地修改或插入：和追加一样处理，右侧相邻的两段连线也要重绘
+/// 插入到压缩部分（first 为-1）时不知道具体位置，整体重绘
+void LineChart::onPointsChanged(int index, int first, int count)
 {
-    Q_ASSERT(index < datas.size());
-    datas.removeAt(index);
-    update();
+    if (first < 0)
+    {
+        plotCacheValid = false;
+        requestFrame();
+        return ;
+    }
+    updateForPoints(index, first, qMin(count + 2, model->hotCount(index) - first));
+    if (first == 0 && !model->line(index).history.isEmpty()) // 派生折线整体重算，压缩部分也变了
+    {
+        plotCacheValid = false;
+        requestFrame();
+    }
 }
 
-void LineChart::addPoint(int index, int x, int y)
+void LineChart::onXLabelsChanged()
 {
-    saveRange();
-    Q_ASSERT(index < datas.size());
-    displayXMin = qMin(displayXMin, x);
-    displayXMax = qMax(displayXMax, x);
-    displayYMin = qMin(displayYMin, y);
-    displayYMax = qMax(displayYMax, y);
+    requestFrame();
+}
 
-    datas[index].points.append(QPoint(x, y));
-    startRangeAnimation();
+/// 线条层缓存是否正是当前（非动画中的）显示范围
+bool LineChart::plotCacheMatchesDisplay() const
+{
+    const int span = displayXMax - displayXMin;
+    if (!plotCacheValid || animatingXMin || animatingXMax || animatingYMin || animatingYMax
+            || span <= 0 || contentRect.width() <= 0)
+        return false;
+    return cacheXSpan == span && cacheYMin == displayYMin && cacheYMax == displayYMax
+            && qRound((cacheXOrigin - displayXMin) * contentRect.width() / span) == 0;
 }
 
-void LineChart::addPoint(int index, int x, int y, const QString &label)
+/// 新增的点会影响的缓存区域（相对contentRect）：
+/// 前两个点之间的曲线形状、上一个点的数值位置，以及新的线段、圆点与数值
+QRect LineChart::appendedPlotRect(int index, int first, int count) const
 {
-    bool inserted = false;
-    for (int i = xLabels.size() - 1; i >= 0; i--)
+    if (count <= 0 || first + count > model->hotCount(index))
+        return QRect();
+    const int w = contentRect.width(), h = contentRect.height();
+    auto pixelX = [&](int x) {
+        return qFloor((x - cacheXOrigin) * w / cacheXSpan);
+    };
+
+    int margin = pointDotRadius + 2;
+    if (pointValueType)
     {
-        if (xLabelPoss.at(i) == x)
-            break;
-        if (xLabelPoss.at(i) < x)
-        {
-            xLabels.insert(i + 1, label);
-            xLabelPoss.insert(i + 1, x);
-            inserted = true;
-            break;
-        }
+        QFontMetrics fm(font());
+        margin += qMax(fm.horizontalAdvance(QString::number(cacheYMin)), fm.horizontalAdvance(QString::number(cacheYMax)));
     }
-    if (!inserted)
+    int left = w, right = 0;
+    for (int i = qMax(first - 2, 0); i < first + count; i++)
     {
-        xLabels.insert(0, label);
-        xLabelPoss.insert(0, x);
+        int x = pixelX(model->hotPoint(index, i).x());
+        left = qMin(left, x - margin);
+        right = qMax(right, x + margin);
     }
-    addPoint(index, x, y);
+    return QRect(QPoint(left, 0), QPoint(right, h - 1)) & QRect(0, 0, w, h);
 }
 
-void LineChart::removeFirst(int index)
+void LineChart::onPointsEvicted(int index, int, int firstX)
 {
-    Q_ASSERT(index <= datas.size());
-    if (datas.at(index).points.empty())
-        return ;
-    bool equal = (displayXMin == datas.at(index).points.first().x());
-    datas[index].points.removeFirst();
+    // 移除的点都在缓存范围左侧足够远，不影响已绘制的内容
+    int thirdX = 0;
+    if (!model->headX(index, 2, thirdX) || thirdX >= cacheXOrigin)
+        plotCacheValid = false;
+    requestFrame();
 
     // 调整最小值
-    if (equal)
+    if (displayXMin == firstX)
     {
         saveRange();
         int newXMin = displayXMax;
-        for (int i = 0; i < datas.size(); i++)
-            if (!datas.at(i).points.empty())
-            {
-                int x = datas.at(i).points.first().x();
-                if (x < newXMin)
-                    newXMin = x;
-            }
+        for (int i = 0; i < model->lineCount(); i++)
+        {
+            int x = 0;
+            if (model->headX(i, 0, x) && x < newXMin)
+                newXMin = x;
+        }
         displayXMin = newXMin;
         startRangeAnimation();
     }
 }
 
+/// 旧的点被汇总：只有变化的部分与缓存范围相交时才需要重绘
+/// 大多数时候显示的是最近的数据，汇总发生在左侧很远的地方
+void LineChart::onPointsRolledUp(int, int xFrom, int xTo)
+{
+    if (xTo >= cacheXOrigin && xFrom <= cacheXOrigin + cacheXSpan)
+    {
+        plotCacheValid = false;
+        requestFrame();
+    }
+}
+
+void LineChart::onXRangeLinked(int xMin, int xMax, QObject *source)
+{
+    if (!linkXRange || source == this)
+        return ;
+    saveRange();
+    displayXMin = xMin;
+    displayXMax = xMax;
+    startRangeAnimation();
+}
+
+/// 换出到磁盘的块载入了：只有缓存中以占位图案绘制过这个范围时才需要重绘
+/// 包括视图两侧相邻的块（连线用到其中的点），其他时候是预先载入的，不影响已绘制的内容
+void LineChart::onHistoryLoaded(int, int xFrom, int xTo)
+{
+    bool painted = false;
+    for (int i = cacheMissing.size() - 1; i >= 0; i--)
+    {
+        // 块的X起点可能因移除而变大，按相交判断
+        if (cacheMissing.at(i).first <= xTo && cacheMissing.at(i).second >= xFrom)
+        {
+            cacheMissing.removeAt(i);
+            painted = true;
+        }
+    }
+    if (!painted)
+        return ;
+    plotCacheValid = false;
+    requestFrame();
+}
+
+/// 数据整体替换（从快照恢复）后，直接根据数据确定显示范围，不使用动画
+void LineChart::onModelReset()
+{
+    stopAnimations();
+    fitDisplayRangeToData();
+    plotCacheValid = false;
+    update();
+}
+
+void LineChart::onSnapshotWritten(const QString &path, bool ok)
+{
+    emit snapshotSaved(path, ok);
+}
+
+/// 排队的点：使用帧时钟时等到下一帧再取出，否则立即取出
+void LineChart::onPointsQueued()
+{
+    if (useFrameClock)
+        ChartFrameClock::instance()->requestFrame();
+    else
+        drainQueuedPoints();
+}
+
+/// 细化渐进绘制中粗略的部分：每次最多占用 progressiveSlice 毫秒，剩下的留到下一次事件循环
+void LineChart::refinePlotCache()
+{
+    // 缓存已失效（范围、数据、大小改变），下一次绘制时会重新开始
+    if (!plotCacheValid || cacheLowQuality || coarseRect.isEmpty()
+            || plotCache.size() != contentRect.size() * devicePixelRatioF())
+        return ;
+
+    TraceSpan span(trace, "refine");
+    QElapsedTimer timer;
+    timer.start();
+    QRect refined;
+    while (!coarseRect.isEmpty() && timer.elapsed() < progressiveSlice)
+    {
+        QElapsedTimer stripTimer;
+        stripTimer.start();
+        QRect strip(coarseRect.left(), coarseRect.top(), qMin(refineStripWidth, coarseRect.width()), coarseRect.height());
+        renderPlotRect(strip, false);
+        coarseRect.setLeft(strip.right() + 1);
+        refined |= strip;
+
+        // 根据这一段的耗时调整下一段的宽度，每段约占半个时间片
+        double ms = stripTimer.nsecsElapsed() / 1e6;
+        refineTime += ms;
+        if (ms > 0)
+            refineStripWidth = qBound(8, int(strip.width() * progressiveSlice / 2 / ms), qMax(contentRect.width(), 8));
+    }
+    requestFrame(refined.translated(contentRect.topLeft()));
+
+    if (coarseRect.isEmpty())
+        fullRenderTime = refineTime;
+    else
+        refineTimer.start();
+}
+
 /// 更新各个锚点
 void LineChart::updateAnchors()
 {
@@ -210,6 +609,11 @@ void LineChart::updateAnchors()
         selectXEnd = selectXStart;
     }
     emit signalSelectRangeChanged(selectXStart, selectXEnd);
+
+    // 有连接时才计算统计信息
+    static const QMetaMethod statSignal = QMetaMethod::fromSignal(&LineChart::signalSelectRangeStatistics);
+    if (isSignalConnected(statSignal))
+        emit signalSelectRangeStatistics(selectXStart, selectXEnd, rangeStatistics(selectXStart, selectXEnd));
 }
 
 void LineChart::zoom(double prop)
@@ -221,6 +625,8 @@ void LineChart::zoom(double prop)
     displayXMin = selectXStart - int((selectXStart - displayXMin) * prop);
     displayXMax = selectXStart + int((displayXMax - selectXStart) * prop);
     startRangeAnimation();
+    if (linkXRange)
+        model->linkXRange(displayXMin, displayXMax, this);
     updateAnchors();
 }
 
@@ -230,9 +636,115 @@ void LineChart::moveHorizontal(int x)
     displayXMin += x;
     displayXMax += x;
     startRangeAnimation();
+    if (linkXRange)
+        model->linkXRange(displayXMin, displayXMax, this);
     updateAnchors();
 }
 
+/// 某条线在 [xStart, xEnd] 范围内的统计信息，要求X有序
+RangeStatistics LineChart::rangeStatistics(int index, int xStart, int xEnd) const
+{
+    Q_ASSERT(index < model->lineCount());
+    if (xStart > xEnd)
+        qSwap(xStart, xEnd);
+    return model->statistics(index, xStart, xEnd);
+}
+
+/// 所有线在 [xStart, xEnd] 范围内的统计信息
+QList<RangeStatistics> LineChart::rangeStatistics(int xStart, int xEnd) const
+{
+    const QList<ChartData>& datas = model->lines();
+    QList<RangeStatistics> stats;
+    for (int i = 0; i < datas.size(); i++)
+        stats.append(rangeStatistics(i, xStart, xEnd));
+    return stats;
+}
+
+/// 各条折线的数据以及各种缓存占用的内存
+/// 共享模型时，折线数据部分与其他折线图是同一份
+ChartMemoryReport LineChart::memoryReport() const
+{
+    ChartMemoryReport report;
+    for (int i = 0; i < model->lineCount(); i++)
+        report.series.append(model->seriesMemory(i));
+    report.xLabels = model->labelMemory();
+    report.plotCache = qint64(plotCache.width()) * plotCache.height() * plotCache.depth() / 8;
+    report.rasterBuffer = rasterBuffer.sizeInBytes();
+    report.scratch = scratch.memoryBytes();
+    return report;
+}
+
+/// 当前持有的对象、动画、标签、点与内存，长时间运行时应当保持稳定
+ChartResourceStats LineChart::resourceStats() const
+{
+    ChartResourceStats stats;
+    stats.objects = findChildren<QObject*>().size();
+    stats.animations = findChildren<QPropertyAnimation*>().size();
+    stats.labels = model->getXLabels().size();
+    for (int i = 0; i < model->lineCount(); i++)
+        stats.points += model->pointCount(i);
+    stats.memory = memoryReport().total();
+    stats.paintCount = paintCount;
+    stats.paintTime = lastPaintTime;
+    return stats;
+}
+
+/// 完整状态的二进制快照：所有折线的数据、标签、显示范围与样式设置
+/// 点以内存中的原始字节写入，压缩的历史原样写入，恢复时不需要逐个添加
+QByteArray LineChart::saveState() const
+{
+    QByteArray state;
+    QBuffer buffer(&state);
+    buffer.open(QIODevice::WriteOnly);
+    writeSnapshotData(&buffer, saveSettings(), model->takeSnapshot());
+    return state;
+}
+
+/// 从 saveState() 的结果恢复，不产生动画；格式不符时返回false，现有数据不变
+bool LineChart::restoreState(const QByteArray &state)
+{
+    QBuffer buffer;
+    buffer.setData(state);
+    buffer.open(QIODevice::ReadOnly);
+    return readSnapshot(&buffer);
+}
+
+/// 保存快照到文件（先写临时文件，完成后替换）
+bool LineChart::saveSnapshot(const QString &path) const
+{
+    QSaveFile file(path);
+    return file.open(QIODevice::WriteOnly)
+            && writeSnapshotData(&file, saveSettings(), model->takeSnapshot())
+            && file.commit();
+}
+
+/// 在后台线程中保存快照，完成后发出 snapshotSaved；上一次还没写完时跳过
+/// 数据是写时复制的拷贝，写入期间可以继续修改
+void LineChart::saveSnapshotAsync(const QString &path)
+{
+    if (path.isEmpty() || snapshotPool.activeThreadCount())
+        return ;
+    snapshotPool.start(new SnapshotWriteTask(this, path, saveSettings(), model->takeSnapshot()));
+}
+
+bool LineChart::loadSnapshot(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    return readSnapshot(&file);
+}
+
+/// 每隔 intervalMs 毫秒在后台保存一次快照，path 为空或间隔不大于0时停止
+void LineChart::setAutoSnapshot(const QString &path, int intervalMs)
+{
+    snapshotPath = path;
+    if (path.isEmpty() || intervalMs <= 0)
+        snapshotTimer.stop();
+    else
+        snapshotTimer.start(intervalMs);
+}
+
 void LineChart::zoomIn()
 {
     zoom(0.5);
@@ -246,9 +758,19 @@ void LineChart::zoomOut()
 void LineChart::paintEvent(QPaintEvent *event)
 {
     QWidget::paintEvent(event);
+    TraceSpan span(trace, "paintEvent");
+    const QList<ChartData>& datas = model->lines();
+    const QList<QString>& xLabels = model->getXLabels();
+    const QList<int>& xLabelPoss = model->getXLabelPoss();
+
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+
+    // 交互或动画过程中，完整画质整体重绘线条层太慢的话就临时降低画质（复用缓存的帧不算）
+    const bool lowQuality = adaptiveQuality && isInteracting() && fullRenderTime > qualityThreshold;
 
     QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setRenderHint(QPainter::Antialiasing, !lowQuality);
 
     /// 边界
     contentRect = QRect(paddings.left(), paddings.top(),
@@ -257,242 +779,41 @@ void LineChart::paintEvent(QPaintEvent *event)
     painter.setPen(QPen(borderColor, 0.5));
     painter.drawRect(contentRect);
 
-    const int xMin = animatingXMin ? _animatedXMin : displayXMin,
-            xMax = animatingXMax ? _animatedXMax : displayXMax;
+    const int xMin = animatingXMin ? _animatedXMin : displayXMin;
+    int xMax = animatingXMax ? _animatedXMax : displayXMax;
+    // 纯平移时保持宽度不变，避免两个动画各自取整导致宽度抖动、缓存失效
+    if (animatingXMin && animatingXMax && _savedXMax - _savedXMin == displayXMax - displayXMin)
+        xMax = xMin + (displayXMax - displayXMin);
     const int yMin = animatingYMin ? _animatedYMin : displayYMin,
             yMax = animatingYMax ? _animatedYMax : displayYMax;
 
-    if (datas.empty() || xMin >= xMax || yMin >= yMax)
+    if (datas.empty() || xMin >= xMax || yMin >= yMax || contentRect.width() <= 0 || contentRect.height() <= 0)
         return ;
 
     QFontMetrics fm(painter.font());
     int lineSpacing = fm.height();
-    QPoint accessNearestPos = hoverPos;
-    int accessMinDis = 0x3f3f3f3f;
 
-    /// 画线条与数值
-    painter.save();
-    QPainterPath contentPath;
-    painter.setClipRect(contentRect);
-    for (int i = 0; i < datas.size(); i++)
+    /// 画线条与数值（缓存起来，横向平移时只重绘新露出的部分）
+    const bool rerender = !plotCacheMatchesDisplay();
     {
-        // 计算点要绘制的所有坐标
-        QList<QPoint> displayPoints;
-        const ChartData& line = datas.at(i);
-        for (int j = 0; j < line.points.size(); j++)
-        {
-            const QPoint& pt = line.points.at(j);
-            const QPoint contentPt(
-                        contentRect.width() * (pt.x() - xMin) / (xMax - xMin),
-                        contentRect.height() * (pt.y() - yMin) / (yMax - yMin)
-                        );
-            const QPoint dispt(
-                        contentRect.left() + contentPt.x(),
-                        contentRect.bottom() - contentPt.y()
-                        );
-            displayPoints.append(dispt);
-        }
-
-        // 连线
-        if (pointLineType && displayPoints.size() > 1)
-        {
-            // 源码参考：https://github.com/AlloyTeam/curvejs/blob/master/src/smooth-curve.js
-            const auto& points = displayPoints;
-            QPainterPath path;
-            if (pointLineType == 1) // 直线
-            {
-                path.moveTo(points.first());
-                for (int i = 1; i < points.size(); i++)
-                    path.lineTo(points.at(i));
-            }
-            else if (pointLineType == 2) // 二次贝塞尔曲线
-            {
-                path.moveTo(points.at(0));
-                for (int i = 1; i < points.size() - 1; i++)
-                {
-                    if (i == points.size() - 2)
-                    {
-                        path.quadTo(points.at(i), points.at(i + 1));
-                    }
-                    else
-                    {
-                        path.quadTo(points.at(i),
-                                    QPoint((points.at(i).x() + points.at(i+1).x())/2,
-                                           (points.at(i).y() + points.at(i+1).y())/2));
-                    }
-                }
-            }
-            else if (pointLineType == 3) // 三次贝塞尔曲线
-            {
-                // 算法参考：https://juejin.cn/post/6844903477273952270
-                // 源码参考：https://github.com/AlloyTeam/curvejs/blob/master/asset/smooth.html
-                double rt = 0.2; // 平滑度
-                QList<Vector2D> controlPoints;
-                int count = points.size() - 2;
-                for (int i = 0; i < count; i++)
-                {
-                    QPoint a = points.at(i), b = points.at(i+1), c = points.at(i+2);
-                    Vector2D v1(a - b);
-                    Vector2D v2(c - b);
-                    double v1Len = v1.length(), v2Len = v2.length();
-                    Vector2D centerV = (v1.normalize() + v2.normalize()).normalize();
-
-                    Vector2D ncp1(centerV.y(), centerV.x() * - 1);
-                    Vector2D ncp2(centerV.y() * -1, centerV.x());
-                    if (ncp1.angle(v1) < 90)
-                    {
-                        Vector2D p1 = ncp1 * (v1Len * rt) + b;
-                        Vector2D p2 = ncp2 * (v2Len * rt) + b;
-                        controlPoints.append(p1);
-                        controlPoints.append(p2);
-                    }
-                    else
-                    {
-                        Vector2D p1 = ncp1 * (v2Len * rt) + b;
-                        Vector2D p2 = ncp2 * (v1Len * rt) + b;
-                        controlPoints.append(p2);
-                        controlPoints.append(p1);
-                    }
-                }
-
-                path.moveTo(points.at(0));
-                path.cubicTo(points.at(0), controlPoints.at(0), points.at(1));
-                for (int i = 1; i < count; i++)
-                {
-                    path.cubicTo(controlPoints.at(i * 2 - 1), controlPoints.at(i * 2), QPointF(points.at(i+1)));
-                }
-                path.cubicTo(controlPoints.last(), points.last(), points.last());
-            }
-            painter.setPen(line.color);
-            painter.drawPath(path);
-
-            // 画选区效果
-            if (selecting)
-            {
-                int startX = pressPos.x(), endX = hoverPos.x();
-                QPainterPath downPath = path;
-                downPath.lineTo(points.last().x(), contentRect.bottom());
-                downPath.lineTo(points.first().x(), contentRect.bottom());
-                downPath.lineTo(points.first());
-                QRect clipRect(startX, contentRect.top(), endX - startX, contentRect.height());
-                painter.save();
-                painter.setClipRect(clipRect);
-                QLinearGradient lg = QLinearGradient(QPointF(0, 0), QPointF(0, contentRect.height()));
-                QColor c = line.color;
-                c.setAlpha(line.color.alpha() / 3);
-                lg.setColorAt(0.0, c);
-                c.setAlpha(4);
-                lg.setColorAt(1.0, c);
-                painter.fillPath(downPath, lg);
-                painter.restore();
-            }
-        }
-
-        // 绘制点的小圆点
-        if (pointDotType)
-        {
-            for (int i = 0; i < displayPoints.size(); i++)
-            {
-                const QPoint& pt = displayPoints.at(i);
-                QRect pointRect(pt.x() - pointDotRadius, pt.y() - pointDotRadius, pointDotRadius * 2, pointDotRadius * 2);
-                if (pointDotType == 1) // 空心圆
-                {
-                    painter.drawEllipse(pointRect);
-                }
-                else if (pointDotType == 2) // 实心圆
-                {
-                    QPainterPath path;
-                    path.addEllipse(pointRect);
-                    painter.fillPath(path, line.color);
-                }
-                else if (pointDotType == 3) // 小方块
-                {
-                    painter.fillRect(pointRect, line.color);
-                }
-            }
-        }
-
-        // 绘制所有点的数值
-        if (pointValueType)
-        {
-            const QList<QPoint>& points = line.points;
-            for (int i = 0; i < points.size(); i++)
-            {
-                QString text = QString::number(points.at(i).y());
-                QPoint pos = displayPoints.at(i);
-                if (pos.x() < contentRect.left() || pos.x() > contentRect.right())
-                    continue;
-                int w = fm.horizontalAdvance(text);
-                int x = pos.x() - w / 2;
-                int y = pos.y() - pointDotRadius - fm.leading(); // 默认是强制正上方位置
-                if (pointValueType == 2) // 所有，自动选取合适的
-                {
-                    if (i == 0 && i < points.size() - 1)
-                    {
-                        if (points.at(i + 1).y() > points.at(i).y()) // 显示在下方
-                            y = pos.y() + lineSpacing + pointDotRadius;
-                    }
-                    else if (i > 0 && i < points.size() - 1)
-                    {
-                        int v = points.at(i).y();
-                        int vl = points.at(i-1).y();
-                        int vr = points.at(i+1).y();
-                        if (vl > v && vr > v) // V型，显示在下面
-                            y = pos.y() + lineSpacing + pointDotRadius;
-                        else if (vl < v && vr > v) // 显示偏左
-                            x -= w / 2;
-                        else if (vl > v && vr < v) // 显示偏右
-                            x += w / 2;
-                        // TODO: 还可以根据两侧斜率来进一步优化
-                    }
-                    else if (i == points.size() - 1 && points.size() > 1)
-                    {
-                        if (points.at(i-1).y() > points.at(i).y()) // 显示在下方
-                            y = pos.y() + lineSpacing + pointDotRadius;
-                    }
-                }
-                else if (pointValueType == 3) // 选合适的进行显示
-                {
-                    // TODO: 判断密集程度
-                    continue;
-                }
-
-                // 判断超出边界
-                if (x - w / 2 < contentRect.left())
-                    x = contentRect.left();
-                else if (x + w > contentRect.right())
-                    x = contentRect.right() - w;
-                if (y - lineSpacing < contentRect.top())
-                    y = pos.y() + lineSpacing + pointDotRadius;
-                else if (y > contentRect.bottom())
-                    y = pos.y() - pointDotRadius - fm.leading();
-
-                // 绘制文字
-                painter.drawText(QPoint(x, y), text);
-            }
-
-        }
-
-        // 计算距离最近的点
-        if (hovering && contentRect.contains(hoverPos))
-        {
-            for (int i = 0; i < displayPoints.size(); i++)
-            {
-                const QPoint& pt = displayPoints.at(i);
-                if (qAbs(hoverPos.x() - pt.x()) > nearDis || qAbs(hoverPos.y() - pt.y()) > nearDis)
-                    continue;
-                int distance = (hoverPos - displayPoints.at(i)).manhattanLength();
-                if (distance < accessMinDis)
-                {
-                    accessNearestPos = displayPoints.at(i);
-                    accessMinDis = distance;
-                }
-            }
-        }
+        TraceSpan stage(trace, "plotCache");
+        updatePlotCache(xMin, xMax, yMin, yMax, lowQuality);
+        painter.drawPixmap(contentRect.topLeft(), plotCache);
+    }
+
+    // 画选区效果
+    if (selecting)
+    {
+        TraceSpan stage(trace, "selection");
+        paintSelection(painter, xMin, xMax, yMin, yMax, lowQuality);
     }
-    painter.restore();
 
-    if (accessMinDis != 0x3f3f3f3f)
+    // 计算距离最近的点
+    QPoint accessNearestPos = hoverPos;
+    bool accessed = hovering && contentRect.contains(hoverPos)
+            && findNearestPoint(hoverPos, xMin, xMax, yMin, yMax, accessNearestPos);
+
+    if (accessed)
     {
         painter.save();
         painter.setPen(hightlightColor);
@@ -503,9 +824,9 @@ void LineChart::paintEvent(QPaintEvent *event)
         }
         else if (pointDotType == 2) // 实心圆
         {
-            QPainterPath path;
-            path.addEllipse(pointRect);
-            painter.fillPath(path, hightlightColor);
+            scratch.dotPath.clear();
+            scratch.dotPath.addEllipse(pointRect);
+            painter.fillPath(scratch.dotPath, hightlightColor);
         }
         else if (pointDotType == 3) // 小方块
         {
@@ -516,6 +837,7 @@ void LineChart::paintEvent(QPaintEvent *event)
 
 
     /// 画坐标轴
+    const qint64 axesStart = trace ? trace->now() : 0;
     // 画X轴数值
     int lastRight = 0; // 上一次绘图的位置
     if (usePointXLabels && xLabels.size()) // 使用传入的label，可以是和数据对应的任意字符串
@@ -536,7 +858,8 @@ void LineChart::paintEvent(QPaintEvent *event)
     else // 使用 xMin ~ xMax 的 int
     {
         bool highlighted = false;
-        int maxTextWidth = qMax(fm.horizontalAdvance(QString::number(xMin)), fm.horizontalAdvance(QString::number(xMax)));
+        int maxTextWidth = fm.horizontalAdvance(numberText(xMin));
+        maxTextWidth = qMax(maxTextWidth, fm.horizontalAdvance(numberText(xMax)));
         int displayCount = qMax((contentRect.width() + labelSpacing) / (maxTextWidth + labelSpacing), 1); // 最多显示多少个标签
         int step = qMax((xMax - xMin + displayCount) / displayCount, 1);
         for (int i = xMin; i <= xMax; i += step)
@@ -545,12 +868,12 @@ void LineChart::paintEvent(QPaintEvent *event)
             if (val > xMax - step)
                 val = xMax; // 确保最大值一直显示
             int x = contentRect.width() * (val - xMin) / (xMax - xMin); // 视图x
-            int w = fm.horizontalAdvance(QString::number(val)); // 文字宽度
+            int w = fm.horizontalAdvance(numberText(val)); // 文字宽度
             if (hovering && contentRect.contains(accessNearestPos) && (x + contentRect.left() >= accessNearestPos.x() - w && x + contentRect.left() <= accessNearestPos.x() + w))
             {
                 x = accessNearestPos.x() - contentRect.left();
                 val = (xMax - xMin) * x / contentRect.width() + xMin;
-                w = fm.horizontalAdvance(QString::number(val));
+                w = fm.horizontalAdvance(numberText(val));
                 highlighted = true;
             }
             int l = x - w / 2, r = x + w / 2;
@@ -560,7 +883,7 @@ void LineChart::paintEvent(QPaintEvent *event)
                 painter.save();
                 painter.setPen(hightlightColor);
             }
-            painter.drawText(QPoint(l + contentRect.left(),  contentRect.bottom() + lineSpacing), QString::number(val));
+            painter.drawText(QPoint(l + contentRect.left(),  contentRect.bottom() + lineSpacing), numberText(val));
             if (highlighted)
             {
                 painter.restore();
@@ -596,7 +919,7 @@ void LineChart::paintEvent(QPaintEvent *event)
                 val = (yMax - yMin) * (contentRect.bottom() - y) / contentRect.height() + yMin;
                 highlighted = true;
             }
-            int w = fm.horizontalAdvance(QString::number(val));
+            int w = fm.horizontalAdvance(numberText(val));
 
             if (highlighted)
             {
@@ -605,11 +928,11 @@ void LineChart::paintEvent(QPaintEvent *event)
             }
             if (k == 0) // 左边
             {
-                painter.drawText(QPoint(contentRect.left() - labelSpacing - w, y + lineSpacing / 2), QString::number(val));
+                painter.drawText(QPoint(contentRect.left() - labelSpacing - w, y + lineSpacing / 2), numberText(val));
             }
             else // 右边
             {
-                painter.drawText(QPoint(contentRect.right() + labelSpacing, y + lineSpacing / 2), QString::number(val));
+                painter.drawText(QPoint(contentRect.right() + labelSpacing, y + lineSpacing / 2), numberText(val));
             }
             if (highlighted)
             {
@@ -619,6 +942,9 @@ void LineChart::paintEvent(QPaintEvent *event)
         }
     }
 
+    if (trace)
+        trace->addSpan("axes", axesStart, trace->now());
+
     /// 交互
     // 画悬浮的十字对准线
     if (showCrossOnPressing && hovering && contentRect.contains(accessNearestPos))
@@ -634,6 +960,462 @@ void LineChart::paintEvent(QPaintEvent *event)
     {
         painter.drawLine(selectPos, contentRect.top(), selectPos, contentRect.bottom());
     }
+
+    lastPaintTime = paintTimer.nsecsElapsed() / 1e6;
+    paintCount++;
+    double& frameTime = rerender ? rerenderPaintTime : reusePaintTime; // 帧时钟据此估计下一帧的耗时
+    frameTime = frameTime * 0.7 + lastPaintTime * 0.3;
+
+    // 这次绘制覆盖的X范围内新添加的点已经显示出来
+    const QRect painted = event->rect() & contentRect;
+    if (trace && !painted.isEmpty())
+    {
+        const qint64 xSpan = xMax - xMin, w = contentRect.width();
+        trace->samplesPainted(this, int(xMin + (painted.left() - contentRect.left()) * xSpan / w),
+                              int(xMin + (painted.right() + 1 - contentRect.left()) * xSpan / w));
+        trace->addCounter("pendingSamples", trace->pendingSamples());
+    }
+}
+
+/// 更新线条层的缓存
+/// 范围、大小、画质都没变则直接复用；仅X方向平移则滚动已有图像，只绘制新露出的竖条；否则整体重绘
+void LineChart::updatePlotCache(int xMin, int xMax, int yMin, int yMax, bool lowQuality)
+{
+    const qreal dpr = devicePixelRatioF();
+    const QSize pixmapSize = contentRect.size() * dpr;
+    const int w = contentRect.width(), h = contentRect.height();
+    const int span = xMax - xMin;
+    bool reuse = plotCacheValid && plotCache.size() == pixmapSize
+            && cacheXSpan == span && cacheYMin == yMin && cacheYMax == yMax
+            && cacheLowQuality == lowQuality;
+    QRect dirty(0, 0, w, h); // 需要重绘的部分，相对于 contentRect
+
+    if (reuse)
+    {
+        const int dx = qRound((cacheXOrigin - xMin) * w / span); // 内容需要右移的像素
+        if (!dx && plotDirty.isEmpty())
+            return ;
+        if (!dx) // 只有新增数据的局部
+        {
+            dirty = plotDirty;
+        }
+        else if (!enableScrollBlit || qAbs(dx) >= w || !qFuzzyCompare(dpr, qreal(qRound(dpr))))
+        {
+            reuse = false;
+        }
+        else
+        {
+            plotCache.scroll(qRound(dx * dpr), 0, plotCache.rect());
+            cacheXOrigin -= double(dx) * span / w;
+            dirty = dx > 0 ? QRect(0, 0, dx, h) : QRect(w + dx, 0, -dx, h);
+            if (!plotDirty.isEmpty())
+                dirty |= plotDirty.translated(dx, 0) & QRect(0, 0, w, h);
+            if (!coarseRect.isEmpty()) // 尚未细化的部分跟着移动
+                coarseRect = coarseRect.translated(dx, 0) & QRect(0, 0, w, h);
+        }
+    }
+    plotDirty = QRect();
+
+    if (!reuse)
+    {
+        if (plotCache.size() != pixmapSize)
+        {
+            plotCache = QPixmap(pixmapSize);
+            plotCache.setDevicePixelRatio(dpr);
+        }
+        cacheXOrigin = xMin;
+        cacheXSpan = span;
+        cacheYMin = yMin;
+        cacheYMax = yMax;
+        cacheLowQuality = lowQuality;
+        plotCacheValid = true;
+        coarseRect = QRect();
+        cacheMissing.clear();
+
+        // 完整画质太慢：先画粗略的，剩下的交给 refinePlotCache 分段细化
+        if (progressiveRender && !lowQuality && (fullRenderTime < 0 || fullRenderTime > progressiveSlice))
+        {
+            renderPlotRect(dirty, true);
+            coarseRect = dirty;
+            refineTime = 0;
+            refineTimer.start();
+            return ;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        renderPlotRect(dirty, lowQuality);
+        if (!lowQuality)
+            fullRenderTime = timer.nsecsElapsed() / 1e6;
+        return ;
+    }
+    renderPlotRect(dirty, lowQuality);
+}
+
+/// 在缓存图像中重绘 dirty 区域（相对 contentRect）
+void LineChart::renderPlotRect(const QRect &dirty, bool lowQuality)
+{
+    QPainter painter(&plotCache);
+    painter.setRenderHint(QPainter::Antialiasing, !lowQuality);
+    painter.setFont(font());
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(dirty, Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.setClipRect(dirty);
+    painter.translate(-contentRect.topLeft()); // 之后统一使用控件坐标
+    paintLines(painter, dirty.translated(contentRect.topLeft()), lowQuality);
+}
+
+/// 以缓存的范围绘制 clip 区域（控件坐标）内的线条、圆点与数值
+/// 只计算 clip 附近的点，两侧多取两个点保证曲线连续
+void LineChart::paintLines(QPainter &painter, const QRect &clip, bool lowQuality)
+{
+    const QList<ChartData>& datas = model->lines();
+    const int lineType = lowQuality && pointLineType ? 1 : pointLineType;
+    const int dotType = lowQuality ? 0 : pointDotType;
+    const int valueType = lowQuality ? 0 : pointValueType;
+    const double xOrigin = cacheXOrigin;
+    const int xSpan = cacheXSpan, yMin = cacheYMin, yMax = cacheYMax;
+
+    QFontMetrics fm(painter.font());
+    const int lineSpacing = fm.height();
+    int margin = 0; // 数值文字可能超出点的宽度
+    if (valueType)
+    {
+        margin = fm.horizontalAdvance(numberText(yMin));
+        margin = qMax(margin, fm.horizontalAdvance(numberText(yMax))) + pointDotRadius;
+    }
+    const int fromX = qFloor(xOrigin + double(clip.left() - contentRect.left() - margin) * xSpan / contentRect.width());
+    const int toX = qCeil(xOrigin + double(clip.right() - contentRect.left() + margin) * xSpan / contentRect.width());
+
+    // 光栅绘制的连线先写入缓冲区，连续几条一起绘制；之后用 painter 画其他内容前先绘制，保持前后顺序
+    bool rasterPending = false;
+    auto flushRaster = [&]{
+        if (!rasterPending)
+            return ;
+        painter.drawImage(clip.topLeft(), rasterBuffer);
+        rasterPending = false;
+    };
+    for (int i = 0; i < datas.size(); i++)
+    {
+        // 计算点要绘制的所有坐标
+        const ChartData& line = datas.at(i);
+        QList<QPoint>& points = scratch.points;
+        QList<QPoint>& displayPoints = scratch.displayPoints;
+        QList<QPair<int, int>>& missing = scratch.missing;
+        missing.erase(missing.begin(), missing.end());
+        model->collectPoints(i, fromX, toX, 2, points, &missing, xSpan / contentRect.width());
+        displayPoints.erase(displayPoints.begin(), displayPoints.end());
+        for (int j = 0; j < points.size(); j++)
+            displayPoints.append(mapToPlot(points.at(j), xOrigin, xSpan, yMin, yMax));
+
+        // 还在从磁盘载入的部分，先画占位的斜线
+        if (!missing.isEmpty())
+            flushRaster();
+        for (const QPair<int, int>& range: missing)
+        {
+            if (!cacheMissing.contains(range))
+                cacheMissing.append(range);
+            int left = mapToPlot(QPoint(range.first, yMin), xOrigin, xSpan, yMin, yMax).x();
+            int right = mapToPlot(QPoint(range.second, yMin), xOrigin, xSpan, yMin, yMax).x();
+            painter.fillRect(QRect(left, contentRect.top(), qMax(right - left, 1), contentRect.height()),
+                             QBrush(line.color, Qt::BDiagPattern));
+        }
+        if (lowQuality)
+            decimateByColumn(displayPoints);
+        painter.setPen(line.color);
+
+        // 连线
+        if (lineType && displayPoints.size() > 1)
+        {
+            // 按可见范围内实际要画的段数判断；只重绘一部分时按宽度估计整个视图的段数，与整体重绘的结果一致
+            const qint64 segments = qint64(displayPoints.size() - 1) * contentRect.width() / qMax(clip.width(), 1);
+            bool raster = lineType == 1
+                    && (line.rasterLine || (rasterLineThreshold > 0 && segments > rasterLineThreshold));
+            if (raster) // 直线，直接写入缓冲区
+            {
+                const qreal dpr = devicePixelRatioF();
+                const QSize bufferSize = clip.size() * dpr;
+                if (!rasterPending)
+                {
+                    if (rasterBuffer.size() != bufferSize)
+                        rasterBuffer = QImage(bufferSize, QImage::Format_ARGB32_Premultiplied);
+                    rasterBuffer.setDevicePixelRatio(dpr);
+                    rasterBuffer.fill(Qt::transparent);
+                    rasterPending = true;
+                }
+                RasterLine::drawPolyline(rasterBuffer, displayPoints, line.color, -clip.topLeft(), dpr);
+            }
+            else
+            {
+                flushRaster();
+                buildLinePath(displayPoints, lineType, scratch.path, scratch.controlPoints);
+                painter.drawPath(scratch.path);
+            }
+        }
+
+        // 绘制点的小圆点
+        if (dotType)
+        {
+            flushRaster();
+            for (int i = 0; i < displayPoints.size(); i++)
+            {
+                const QPoint& pt = displayPoints.at(i);
+                QRect pointRect(pt.x() - pointDotRadius, pt.y() - pointDotRadius, pointDotRadius * 2, pointDotRadius * 2);
+                if (dotType == 1) // 空心圆
+                {
+                    painter.drawEllipse(pointRect);
+                }
+                else if (dotType == 2) // 实心圆
+                {
+                    scratch.dotPath.clear();
+                    scratch.dotPath.addEllipse(pointRect);
+                    painter.fillPath(scratch.dotPath, line.color);
+                }
+                else if (dotType == 3) // 小方块
+                {
+                    painter.fillRect(pointRect, line.color);
+                }
+            }
+        }
+
+        // 绘制所有点的数值
+        if (valueType)
+        {
+            flushRaster();
+            for (int i = 0; i < points.size(); i++)
+            {
+                const QString& text = numberText(points.at(i).y());
+                QPoint pos = displayPoints.at(i);
+                if (pos.x() < contentRect.left() || pos.x() > contentRect.right())
+                    continue;
+                int w = fm.horizontalAdvance(text);
+                int x = pos.x() - w / 2;
+                int y = pos.y() - pointDotRadius - fm.leading(); // 默认是强制正上方位置
+                if (valueType == 2) // 所有，自动选取合适的
+                {
+                    if (i == 0 && i < points.size() - 1)
+                    {
+                        if (points.at(i + 1).y() > points.at(i).y()) // 显示在下方
+                            y = pos.y() + lineSpacing + pointDotRadius;
+                    }
+                    else if (i > 0 && i < points.size() - 1)
+                    {
+                        int v = points.at(i).y();
+                        int vl = points.at(i-1).y();
+                        int vr = points.at(i+1).y();
+                        if (vl > v && vr > v) // V型，显示在下面
+                            y = pos.y() + lineSpacing + pointDotRadius;
+                        else if (vl < v && vr > v) // 显示偏左
+                            x -= w / 2;
+                        else if (vl > v && vr < v) // 显示偏右
+                            x += w / 2;
+                        // TODO: 还可以根据两侧斜率来进一步优化
+                    }
+                    else if (i == points.size() - 1 && points.size() > 1)
+                    {
+                        if (points.at(i-1).y() > points.at(i).y()) // 显示在下方
+                            y = pos.y() + lineSpacing + pointDotRadius;
+                    }
+                }
+                else if (valueType == 3) // 选合适的进行显示
+                {
+                    // TODO: 判断密集程度
+                    continue;
+                }
+
+                // 判断超出边界
+                if (x - w / 2 < contentRect.left())
+                    x = contentRect.left();
+                else if (x + w > contentRect.right())
+                    x = contentRect.right() - w;
+                if (y - lineSpacing < contentRect.top())
+                    y = pos.y() + lineSpacing + pointDotRadius;
+                else if (y > contentRect.bottom())
+                    y = pos.y() - pointDotRadius - fm.leading();
+
+                // 绘制文字
+                painter.drawText(QPoint(x, y), text);
+            }
+        }
+    }
+    flushRaster();
+}
+
+/// 画选区内每条线下方的纵向渐变
+void LineChart::paintSelection(QPainter &painter, int xMin, int xMax, int yMin, int yMax, bool lowQuality)
+{
+    const QList<ChartData>& datas = model->lines();
+    const int lineType = lowQuality && pointLineType ? 1 : pointLineType;
+    if (!lineType)
+        return ;
+    QRect clipRect = QRect(QPoint(pressPos.x(), contentRect.top()), QPoint(hoverPos.x(), contentRect.bottom())).normalized();
+    clipRect &= contentRect;
+    const int fromX = qFloor(xMin + double(clipRect.left() - contentRect.left()) * (xMax - xMin) / contentRect.width());
+    const int toX = qCeil(xMin + double(clipRect.right() - contentRect.left()) * (xMax - xMin) / contentRect.width());
+
+    painter.save();
+    painter.setClipRect(clipRect);
+    for (int i = 0; i < datas.size(); i++)
+    {
+        const ChartData& line = datas.at(i);
+        QList<QPoint>& points = scratch.points;
+        model->collectPoints(i, fromX, toX, 2, points, nullptr, (xMax - xMin) / contentRect.width());
+        for (int j = 0; j < points.size(); j++)
+            points[j] = mapToPlot(points.at(j), xMin, xMax - xMin, yMin, yMax);
+        if (points.size() < 2)
+            continue;
+
+        QPainterPath& downPath = scratch.path;
+        buildLinePath(points, lineType, downPath, scratch.controlPoints);
+        downPath.lineTo(points.last().x(), contentRect.bottom());
+        downPath.lineTo(points.first().x(), contentRect.bottom());
+        downPath.lineTo(points.first());
+        QLinearGradient lg = QLinearGradient(QPointF(0, 0), QPointF(0, contentRect.height()));
+        QColor c = line.color;
+        c.setAlpha(line.color.alpha() / 3);
+        lg.setColorAt(0.0, c);
+        c.setAlpha(4);
+        lg.setColorAt(1.0, c);
+        painter.fillPath(downPath, lg);
+    }
+    painter.restore();
+}
+
+/// 查找鼠标附近（nearDis 以内）最近的点，只检查附近X范围内的数据
+bool LineChart::findNearestPoint(QPoint pos, int xMin, int xMax, int yMin, int yMax, QPoint &nearest) const
+{
+    const QList<ChartData>& datas = model->lines();
+    const int fromX = qFloor(xMin + double(pos.x() - nearDis - contentRect.left()) * (xMax - xMin) / contentRect.width());
+    const int toX = qCeil(xMin + double(pos.x() + nearDis - contentRect.left()) * (xMax - xMin) / contentRect.width());
+    int minDis = 0x3f3f3f3f;
+    for (int i = 0; i < datas.size(); i++)
+    {
+        QList<QPoint>& points = scratch.points;
+        model->collectPoints(i, fromX, toX, 0, points);
+        for (int j = 0; j < points.size(); j++)
+        {
+            const QPoint pt = mapToPlot(points.at(j), xMin, xMax - xMin, yMin, yMax);
+            if (qAbs(pos.x() - pt.x()) > nearDis || qAbs(pos.y() - pt.y()) > nearDis)
+                continue;
+            int distance = (pos - pt).manhattanLength();
+            if (distance < minDis)
+            {
+                nearest = pt;
+                minDis = distance;
+            }
+        }
+    }
+    return minDis != 0x3f3f3f3f;
+}
+
+/// 数据坐标转换为控件坐标
+QPoint LineChart::mapToPlot(const QPoint &pt, double xOrigin, int xSpan, int yMin, int yMax) const
+{
+    return QPoint(contentRect.left() + qFloor((pt.x() - xOrigin) * contentRect.width() / xSpan),
+                  contentRect.bottom() - contentRect.height() * (pt.y() - yMin) / (yMax - yMin));
+}
+
+/// 根据连线类型生成经过所有点的路径，path 与 controlPoints 清空后复用
+void LineChart::buildLinePath(const QList<QPoint> &points, int lineType, QPainterPath &path, QVector<Vector2D> &controlPoints)
+{
+    // 源码参考：https://github.com/AlloyTeam/curvejs/blob/master/src/smooth-curve.js
+    path.clear();
+    controlPoints.clear();
+    if (points.size() < 2)
+        return ;
+    if (lineType == 1) // 直线
+    {
+        path.moveTo(points.first());
+        for (int i = 1; i < points.size(); i++)
+            path.lineTo(points.at(i));
+    }
+    else if (lineType == 2) // 二次贝塞尔曲线
+    {
+        path.moveTo(points.at(0));
+        if (points.size() == 2)
+            path.lineTo(points.at(1));
+        for (int i = 1; i < points.size() - 1; i++)
+        {
+            if (i == points.size() - 2)
+            {
+                path.quadTo(points.at(i), points.at(i + 1));
+            }
+            else
+            {
+                path.quadTo(points.at(i),
+                            QPoint((points.at(i).x() + points.at(i+1).x())/2,
+                                   (points.at(i).y() + points.at(i+1).y())/2));
+            }
+        }
+    }
+    else if (lineType == 3) // 三次贝塞尔曲线
+    {
+        // 算法参考：https://juejin.cn/post/6844903477273952270
+        // 源码参考：https://github.com/AlloyTeam/curvejs/blob/master/asset/smooth.html
+        if (points.size() == 2)
+        {
+            path.moveTo(points.at(0));
+            path.lineTo(points.at(1));
+            return ;
+        }
+        double rt = 0.2; // 平滑度
+        int count = points.size() - 2;
+        for (int i = 0; i < count; i++)
+        {
+            QPoint a = points.at(i), b = points.at(i+1), c = points.at(i+2);
+            Vector2D v1(a - b);
+            Vector2D v2(c - b);
+            double v1Len = v1.length(), v2Len = v2.length();
+            Vector2D centerV = (v1.normalize() + v2.normalize()).normalize();
+
+            Vector2D ncp1(centerV.y(), centerV.x() * - 1);
+            Vector2D ncp2(centerV.y() * -1, centerV.x());
+            if (ncp1.angle(v1) < 90)
+            {
+                Vector2D p1 = ncp1 * (v1Len * rt) + b;
+                Vector2D p2 = ncp2 * (v2Len * rt) + b;
+                controlPoints.append(p1);
+                controlPoints.append(p2);
+            }
+            else
+            {
+                Vector2D p1 = ncp1 * (v2Len * rt) + b;
+                Vector2D p2 = ncp2 * (v1Len * rt) + b;
+                controlPoints.append(p2);
+                controlPoints.append(p1);
+            }
+        }
+
+        path.moveTo(points.at(0));
+        path.cubicTo(points.at(0), controlPoints.at(0), points.at(1));
+        for (int i = 1; i < count; i++)
+        {
+            path.cubicTo(controlPoints.at(i * 2 - 1), controlPoints.at(i * 2), QPointF(points.at(i+1)));
+        }
+        path.cubicTo(controlPoints.last(), points.last(), points.last());
+    }
+}
+
+/// 整数转为文字，写入复用的字符串（下一次调用前有效）
+const QString &LineChart::numberText(int value) const
+{
+    QChar digits[12];
+    int count = 0;
+    qint64 v = qAbs(qint64(value));
+    do
+    {
+        digits[count++] = QChar('0' + int(v % 10));
+        v /= 10;
+    } while (v);
+
+    QString& text = scratch.text;
+    text.resize(0);
+    if (value < 0)
+        text.append(QLatin1Char('-'));
+    while (count)
+        text.append(digits[--count]);
+    return text;
 }
 
 void LineChart::enterEvent(QEvent *event)
@@ -715,7 +1497,7 @@ void LineChart::wheelEvent(QWheelEvent *event)
 {
     QWidget::wheelEvent(event);
 
-    auto modifiers = QApplication::keyboardModifiers();
+    auto modifiers = event->modifiers();
     int delta = event->delta();
     if (modifiers & Qt::ControlModifier) // 缩放
     {
@@ -733,7 +1515,7 @@ void LineChart::wheelEvent(QWheelEvent *event)
 void LineChart::setDisplayXMin(int v)
 {
     this->_animatedXMin = v;
-    update();
+    requestFrame();
 }
 
 int LineChart::getDisplayXMin() const
@@ -744,7 +1526,7 @@ int LineChart::getDisplayXMin() const
 void LineChart::setDisplayXMax(int v)
 {
     this->_animatedXMax = v;
-    update();
+    requestFrame();
 }
 
 int LineChart::getDisplayXMax() const
@@ -755,7 +1537,7 @@ int LineChart::getDisplayXMax() const
 void LineChart::setDisplayYMin(int v)
 {
     this->_animatedYMin = v;
-    update();
+    requestFrame();
 }
 
 int LineChart::getDisplayYMin() const
@@ -766,7 +1548,7 @@ int LineChart::getDisplayYMin() const
 void LineChart::setDisplayYMax(int v)
 {
     this->_animatedYMax = v;
-    update();
+    requestFrame();
 }
 
 int LineChart::getDisplayYMax() const
@@ -774,6 +1556,131 @@ int LineChart::getDisplayYMax() const
     return this->_animatedYMax;
 }
 
+/// 显示范围与样式设置
+QByteArray LineChart::saveSettings() const
+{
+    QByteArray settings;
+    QDataStream out(&settings, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << displayXMin << displayXMax << displayYMin << displayYMax
+        << usePointXLabels << pointLineType << pointValueType << pointDotType << pointDotRadius << labelSpacing
+        << autoFitY << autoFitPadding << rasterLineThreshold << adaptiveQuality << qualityThreshold
+        << enableScrollBlit << progressiveRender << progressiveSlice << linkXRange;
+    return settings;
+}
+
+void LineChart::restoreSettings(const QByteArray &settings)
+{
+    QDataStream in(settings);
+    in.setVersion(QDataStream::Qt_5_6);
+    in >> displayXMin >> displayXMax >> displayYMin >> displayYMax
+       >> usePointXLabels >> pointLineType >> pointValueType >> pointDotType >> pointDotRadius >> labelSpacing
+       >> autoFitY >> autoFitPadding >> rasterLineThreshold >> adaptiveQuality >> qualityThreshold
+       >> enableScrollBlit >> progressiveRender >> progressiveSlice >> linkXRange;
+    stopAnimations();
+    plotCacheValid = false;
+    update();
+}
+
+/// 读取快照：检查文件头，恢复模型数据，再恢复设置与显示范围
+bool LineChart::readSnapshot(QIODevice *device)
+{
+    QDataStream in(device);
+    in.setVersion(QDataStream::Qt_5_6);
+    quint32 magic = 0, version = 0;
+    quint8 byteOrder = 0;
+    QByteArray settings;
+    in >> magic >> version >> byteOrder >> settings;
+    if (in.status() != QDataStream::Ok || magic != SnapshotMagic || version != SnapshotVersion
+            || byteOrder != quint8(QSysInfo::ByteOrder))
+    {
+        qWarning() << "不支持的快照格式";
+        return false;
+    }
+    if (!model->restoreSnapshot(in))
+    {
+        qWarning() << "快照数据有误";
+        return false;
+    }
+    restoreSettings(settings);
+    return true;
+}
+
+/// 停止正在进行的范围动画，直接显示目标范围
+void LineChart::stopAnimations()
+{
+    for (QPropertyAnimation* ani: findChildren<QPropertyAnimation*>(QString(), Qt::FindDirectChildrenOnly))
+        ani->stop();
+    animatingXMin = animatingXMax = animatingYMin = animatingYMax = false;
+}
+
+/// 请求重绘：使用帧时钟时先登记，由时钟在下一帧和其他折线图一起提交
+void LineChart::requestFrame(const QRect &rect)
+{
+    if (!useFrameClock)
+    {
+        if (rect.isNull())
+            update();
+        else
+            update(rect);
+        return ;
+    }
+    pendingRect |= rect.isNull() ? this->rect() : rect;
+    framePending = true;
+    ChartFrameClock::instance()->requestFrame();
+}
+
+/// 把排队的点按折线分批加入模型，每批只触发一次刷新
+void LineChart::drainQueuedPoints()
+{
+    QList<QPair<int, QPoint>> points;
+    {
+        QMutexLocker locker(&queueMutex);
+        points.swap(queuedPoints);
+        drainScheduled = false;
+    }
+    QList<QPoint> batch;
+    for (int i = 0; i < points.size(); i++)
+    {
+        batch.append(points.at(i).second);
+        if (i + 1 == points.size() || points.at(i + 1).first != points.at(i).first)
+        {
+            if (points.at(i).first < model->lineCount())
+                model->addPoints(points.at(i).first, batch);
+            batch.erase(batch.begin(), batch.end());
+        }
+    }
+}
+
+/// 是否有可能被看到：显示中、窗口未最小化、没有被完全遮挡
+bool LineChart::isOnScreen() const
+{
+    return isVisible() && !window()->isMinimized() && !visibleRegion().isEmpty();
+}
+
+/// 提交的重绘预计的耗时(ms)：线条层缓存能否复用，耗时相差很大
+double LineChart::pendingFrameCost() const
+{
+    if (!framePending)
+        return 0;
+    return plotCacheMatchesDisplay() ? reusePaintTime : rerenderPaintTime;
+}
+
+void LineChart::presentFrame()
+{
+    update(pendingRect);
+    pendingRect = QRect();
+    framePending = false;
+}
+
+/// 不可见时不绘制，动画直接结束；重新显示时Qt会整体重绘
+void LineChart::skipFrame()
+{
+    stopAnimations();
+    pendingRect = QRect();
+    framePending = false;
+}
+
 void LineChart::saveRange()
 {
     _savedXMin = displayXMin;
@@ -784,9 +1691,11 @@ void LineChart::saveRange()
 
 void LineChart::startRangeAnimation()
 {
+    if (autoFitY)
+        fitVisibleYRange();
     if (!enableAnimation)
     {
-        update();
+        requestFrame();
         return ;
     }
     if (_savedXMin != displayXMin)
@@ -797,12 +1706,43 @@ void LineChart::startRangeAnimation()
         startAnimation("display_y_min", _savedYMin, displayYMin, &animatingYMin);
     if (_savedYMax != displayYMax)
         startAnimation("display_y_max", _savedYMax, displayYMax, &animatingYMax);
-    update();
+    requestFrame();
+}
+
+/// 通过区间索引查询可见X范围内所有线的最值，设置为新的Y范围
+/// 可见范围内没有点时保持不变
+bool LineChart::fitVisibleYRange()
+{
+    const QList<ChartData>& datas = model->lines();
+    bool found = false;
+    int yMin = 0, yMax = 0;
+    for (int i = 0; i < datas.size(); i++)
+    {
+        RangeStatistics stat = model->statistics(i, displayXMin, displayXMax);
+        if (!stat.count)
+            continue;
+        int mi = stat.min, ma = stat.max;
+        yMin = found ? qMin(yMin, mi) : mi;
+        yMax = found ? qMax(yMax, ma) : ma;
+        found = true;
+    }
+    if (!found)
+        return false;
+
+    int pad = int((yMax - yMin) * autoFitPadding);
+    if (yMax == yMin)
+        pad = int(qAbs(yMax) * autoFitPadding);
+    pad = qMax(pad, 1);
+    displayYMin = yMin - pad;
+    displayYMax = yMax + pad;
+    return true;
 }
 
 QPropertyAnimation *LineChart::startAnimation(const QByteArray &property, int start, int end, bool *flag, int duration, QEasingCurve curve)
 {
     *flag = true;
+    ChartTrace* animTrace = trace;
+    const qint64 started = animTrace ? animTrace->now() : 0;
     QPropertyAnimation* ani = new QPropertyAnimation(this, property);
     ani->setStartValue(start);
     ani->setEndValue(end);
@@ -815,7 +1755,9 @@ QPropertyAnimation *LineChart::startAnimation(const QByteArray &property, int st
     });
     connect(ani, &QPropertyAnimation::finished, this, [=]{
         *flag = false;
-        update();
+        if (animTrace)
+            animTrace->addSpan("rangeAnimation", started, animTrace->now());
+        requestFrame();
     });
     ani->start();
     return ani;
@@ -825,3 +1767,35 @@ int LineChart::getValueByCursorPos(QPoint pos)
 {
     return (displayXMax - displayXMin) * (pos.x() - contentRect.left()) / contentRect.width() + displayXMin;
 }
+
+/// 每个像素列只保留第一个、最小、最大、最后一个点（保持原顺序）
+void LineChart::decimateByColumn(QList<QPoint> &points)
+{
+    if (points.size() < 4)
+        return ;
+    int write = 0; // 原地压缩，写入位置不会超过正在读取的位置
+    int start = 0;
+    while (start < points.size())
+    {
+        const int x = points.at(start).x();
+        int end = start, minI = start, maxI = start;
+        while (end + 1 < points.size() && points.at(end + 1).x() == x)
+        {
+            end++;
+            if (points.at(end).y() < points.at(minI).y())
+                minI = end;
+            if (points.at(end).y() > points.at(maxI).y())
+                maxI = end;
+        }
+        const int keeps[4] = { start, qMin(minI, maxI), qMax(minI, maxI), end };
+        int last = -1;
+        for (int k: keeps)
+        {
+            if (k != last)
+                points[write++] = points.at(k);
+            last = k;
+        }
+        start = end + 1;
+    }
+    points.erase(points.begin() + write, points.end());
+}
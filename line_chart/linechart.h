@@ -4,22 +4,18 @@
 #include <QObject>
 #include <QWidget>
 #include <QList>
+#include <QVector>
 #include <QPainter>
 #include <QPainterPath>
+#include <QPixmap>
 #include <QPropertyAnimation>
+#include <QTimer>
+#include <QThreadPool>
+#include <QMutex>
 #include <QtMath>
-
-struct ChartData
-{
-    QString title;
-    QColor color = Qt::black;
-    int xMin = 0;
-    int xMax = 0;
-    int yMin = 0;
-    int yMax = 0;
-    QList<QPoint> points;
-    QList<QString> xLabels; // X显示的名字，可空，比如日期
-};
+#include "chartseriesmodel.h"
+#include "rasterline.h"
+#include "charttrace.h"
 
 struct Vector2D : public QPointF
 {
@@ -74,9 +70,49 @@ struct Vector2D : public QPointF
     }
 };
 
+/// 绘制时使用的临时缓冲区，由折线图持有并在帧之间复用
+/// 使用前清空但保留容量，稳定后每帧不再重新分配内存
+struct PaintScratch
+{
+    QList<QPoint> points;                   // 数据坐标
+    QList<QPoint> displayPoints;            // 控件坐标
+    QList<QPair<int, int>> missing;         // 尚未从磁盘载入的X范围
+    QVector<Vector2D> controlPoints;        // 三次贝塞尔曲线的控制点
+    QPainterPath path;                      // 连线或选区的路径
+    QPainterPath dotPath;                   // 实心圆点
+    QString text;                           // 数值文字
+
+    qint64 memoryBytes() const;
+};
+
+/// 折线图的内存占用（字节，按容量估算）
+struct ChartMemoryReport
+{
+    QList<SeriesMemory> series;             // 每条折线的数据
+    qint64 xLabels = 0;                     // 共用的X轴标签
+    qint64 plotCache = 0;                   // 线条层缓存图像
+    qint64 rasterBuffer = 0;                // 光栅快速绘制的缓冲区
+    qint64 scratch = 0;                     // 每帧复用的临时缓冲区（按最近一帧）
+
+    qint64 total() const;
+};
+
+/// 折线图持有的资源数量，用于长时间运行时检查泄漏
+struct ChartResourceStats
+{
+    int objects = 0;                        // 折线图之下的 QObject（包括动画）
+    int animations = 0;                     // 进行中或等待删除的属性动画
+    int labels = 0;                         // 模型中的X轴标签
+    qint64 points = 0;                      // 所有折线的点数（包括压缩部分）
+    qint64 memory = 0;                      // memoryReport().total()
+    qint64 paintCount = 0;                  // 累计绘制的次数
+    double paintTime = 0;                   // 最近一次绘制的耗时(ms)
+};
+
 class LineChart : public QWidget
 {
     Q_OBJECT
+    friend class ChartFrameClock;
     Q_PROPERTY(int display_x_min READ getDisplayXMin WRITE setDisplayXMin)
     Q_PROPERTY(int display_x_max READ getDisplayXMax WRITE setDisplayXMax)
     Q_PROPERTY(int display_y_min READ getDisplayYMin WRITE setDisplayYMin)
@@ -84,31 +120,78 @@ class LineChart : public QWidget
 
 public:
     LineChart(QWidget *parent = nullptr);
+    ~LineChart() override;
 
     int lineCount() const;
+    void setModel(ChartSeriesModel* model);
+    ChartSeriesModel* getModel() const;
+    void setLinkXRange(bool link);
     void setPointLineType(int t);
     void setPointValueType(int t);
     void setPointDotType(int t);
     void setPointDotRadius(int r);
     void setLabelSpacing(int s);
+    void setAutoFitY(bool fit, double padding = 0.1);
+    void setRasterLineThreshold(int segments);
+    void setAdaptiveQuality(bool enable, int thresholdMs = 12);
+    void setScrollBlit(bool enable);
+    void setProgressiveRender(bool enable, int sliceMs = 8);
+    void setTrace(ChartTrace* trace);
+    void setFrameClock(bool enable);
+    ChartTrace* getTrace() const;
+    bool isInteracting() const;
 
     void addLine(ChartData data);
     void removeLine(int index);
     void addPoint(int index, int x, int y);
     void addPoint(int index, int x, int y, const QString& label);
+    void queuePoint(int index, int x, int y);
     void removeFirst(int index);
+    int attachSeries(const int* xs, const int* ys, int count, QColor color = Qt::black, const QString& title = QString());
+    int adoptSeries(QVector<int>&& xs, QVector<int>&& ys, QColor color = Qt::black, const QString& title = QString());
+    int addDerivedLine(int source, DerivedSeries::Type type, int window, bool spanX = false,
+                       QColor color = Qt::gray, const QString& title = QString());
 
     void updateAnchors();
     void zoom(double prop);
     void moveHorizontal(int x);
 
+    RangeStatistics rangeStatistics(int index, int xStart, int xEnd) const;
+    QList<RangeStatistics> rangeStatistics(int xStart, int xEnd) const;
+    ChartMemoryReport memoryReport() const;
+    ChartResourceStats resourceStats() const;
+
+    QByteArray saveState() const;
+    bool restoreState(const QByteArray& state);
+    bool saveSnapshot(const QString& path) const;
+    void saveSnapshotAsync(const QString& path);
+    bool loadSnapshot(const QString& path);
+    void setAutoSnapshot(const QString& path, int intervalMs = 60000);
+
 signals:
     void signalSelectRangeChanged(int start, int end);
+    void signalSelectRangeStatistics(int start, int end, const QList<RangeStatistics>& stats);
+    void snapshotSaved(const QString& path, bool ok);
 
 public slots:
     void zoomIn();
     void zoomOut();
 
+private slots:
+    void onLineAdded(int index);
+    void onLineRemoved(int index);
+    void onPointsAppended(int index, int first, int count);
+    void onPointsEvicted(int index, int count, int firstX);
+    void onPointsRolledUp(int index, int xFrom, int xTo);
+    void onPointsChanged(int index, int first, int count);
+    void onXRangeLinked(int xMin, int xMax, QObject* source);
+    void onXLabelsChanged();
+    void onHistoryLoaded(int index, int xFrom, int xTo);
+    void refinePlotCache();
+    void onModelReset();
+    void onSnapshotWritten(const QString& path, bool ok);
+    void onPointsQueued();
+
 protected:
     void paintEvent(QPaintEvent *event) override;
     void enterEvent(QEvent *event) override;
@@ -128,15 +211,43 @@ private:
     void setDisplayYMax(int v);
     int getDisplayYMax() const;
 
+    void updatePlotCache(int xMin, int xMax, int yMin, int yMax, bool lowQuality);
+    void renderPlotRect(const QRect& dirty, bool lowQuality);
+    void paintLines(QPainter& painter, const QRect& clip, bool lowQuality);
+    void paintSelection(QPainter& painter, int xMin, int xMax, int yMin, int yMax, bool lowQuality);
+    bool findNearestPoint(QPoint pos, int xMin, int xMax, int yMin, int yMax, QPoint& nearest) const;
+    QPoint mapToPlot(const QPoint& pt, double xOrigin, int xSpan, int yMin, int yMax) const;
+    void updateForPoints(int index, int first, int count);
+    bool plotCacheMatchesDisplay() const;
+    QRect appendedPlotRect(int index, int first, int count) const;
+    static void buildLinePath(const QList<QPoint>& points, int lineType, QPainterPath& path, QVector<Vector2D>& controlPoints);
+    const QString& numberText(int value) const;
+
+    QByteArray saveSettings() const;
+    void restoreSettings(const QByteArray& settings);
+    bool readSnapshot(QIODevice* device);
+    void fitDisplayRangeToData();
+    void stopAnimations();
+
+    void requestFrame(const QRect& rect = QRect());
+    void drainQueuedPoints();
+    bool isOnScreen() const;
+    double pendingFrameCost() const;
+    void presentFrame();
+    void skipFrame();
+
     void saveRange();
     void startRangeAnimation();
+    bool fitVisibleYRange();
     QPropertyAnimation* startAnimation(const QByteArray &property, int start, int end, bool* flag, int duration = 300, QEasingCurve curve = QEasingCurve::OutQuad);
 
     int getValueByCursorPos(QPoint pos);
+    static void decimateByColumn(QList<QPoint>& points);
 
 private:
     // 数据
-    QList<ChartData> datas;                 // 所有折线的数据
+    ChartSeriesModel* model = nullptr;      // 所有折线的数据，可与其他折线图共享
+    bool linkXRange = false;                // 与共享同一模型的其他折线图同步X轴范围
 
     // 界面
     QRect contentRect;                      // 显示的范围，实时刷新
@@ -148,13 +259,58 @@ private:
     bool autoResize = true;                 // 自动调整大小
     int displayXMin = 0, displayXMax = 0;   // 显示的X轴范围
     int displayYMin = 0, displayYMax = 0;   // 显示的Y轴范围
+    bool autoFitY = false;                  // 根据可见X范围内的数值自动调整Y轴范围
+    double autoFitPadding = 0.1;            // 自动调整Y轴时上下留白的比例
     bool usePointXLabels = true;            // 优先使用点对应的label，还是相同间距的数值
-    QList<QString> xLabels;                 // 显示的文字（可能少于值数量）
-    QList<int> xLabelPoss;
     int pointLineType = 3;                  // 连线类型：1直线，2二次贝塞尔曲线，3三次贝塞尔曲线（更精确但吃性能）
     int pointValueType = 2;                 // 数值显示位置：0无，1强制上方，2自动附近
     int pointDotType = 1;                   // 圆点类型：0无，1空心圆，2实心圆，3小方块
     int pointDotRadius = 2;                 // 圆点半径
+    int rasterLineThreshold = 10000;        // 直线连线在可见范围内超过这么多段时自动使用光栅快速绘制，0为不自动
+    QImage rasterBuffer;                    // 光栅快速绘制的缓冲区
+    mutable PaintScratch scratch;           // 每帧复用的临时缓冲区
+    bool adaptiveQuality = false;           // 交互时根据绘制耗时自动降低画质
+    int qualityThreshold = 12;              // 完整画质耗时超过这么多毫秒，交互时降低画质
+    double reusePaintTime = 0;              // 复用线条层缓存时的平均绘制耗时(ms)
+    double rerenderPaintTime = 0;           // 重绘整个线条层时的平均绘制耗时(ms)
+    double lastPaintTime = 0;               // 最近一次绘制的耗时(ms)
+    qint64 paintCount = 0;                  // 累计绘制的次数
+
+    // 线条层缓存
+    bool enableScrollBlit = true;           // 横向平移时滚动复用缓存，只绘制新露出的部分
+    QPixmap plotCache;                      // 线条、圆点、数值的图像（contentRect大小）
+    bool plotCacheValid = false;            // 数据或样式修改后需要整体重绘
+    double cacheXOrigin = 0;                // 缓存图像左边缘对应的X值
+    int cacheXSpan = 0;                     // 缓存时的X范围宽度
+    int cacheYMin = 0, cacheYMax = 0;       // 缓存时的Y范围
+    bool cacheLowQuality = false;           // 缓存是否为降低画质的结果
+    QRect plotDirty;                        // 缓存中需要局部重绘的区域（相对contentRect）
+    QList<QPair<int, int>> cacheMissing;    // 缓存中以占位图案绘制的X范围（还在磁盘上的块）
+
+    // 渐进绘制
+    bool progressiveRender = false;         // 完整绘制太慢时先画粗略的，再在之后的事件循环中分段细化
+    int progressiveSlice = 8;               // 每次细化占用的时间(ms)
+    double fullRenderTime = -1;             // 完整画质整体绘制一次线条层的耗时(ms)，-1为未知；也是降低画质的依据
+    QRect coarseRect;                       // 缓存中尚未细化的区域（相对contentRect）
+    int refineStripWidth = 64;              // 每段细化的宽度，根据耗时调整
+    double refineTime = 0;                  // 本轮细化累计的耗时(ms)
+    QTimer refineTimer;
+
+    // 快照
+    QString snapshotPath;                   // 定时保存的位置
+    QTimer snapshotTimer;
+    QThreadPool snapshotPool;               // 在后台写入快照，同一时间只有一个
+
+    // 性能追踪
+    ChartTrace* trace = nullptr;            // 不持有，为空时不记录
+
+    // 共享帧时钟
+    bool useFrameClock = false;             // 重绘由 ChartFrameClock 统一驱动
+    bool framePending = false;              // 有等待下一帧提交的重绘
+    QRect pendingRect;                      // 等待提交的重绘区域
+    QMutex queueMutex;                      // queuePoint 可在其他线程调用
+    QList<QPair<int, QPoint>> queuedPoints; // 排队等待加入模型的点（折线下标，点）
+    bool drainScheduled = false;            // 已经通知GUI线程取出
 
     // 动画效果
     bool enableAnimation = true;
@@ -0,0 +1,24 @@
+#ifndef POINTSEARCH_H
+#define POINTSEARCH_H
+
+#include <QList>
+#include <QPoint>
+#include <algorithm>
+
+/// 第一个 x >= 指定值的点的下标（点按X递增）
+inline int lowerBoundX(const QList<QPoint>& points, int x)
+{
+    return int(std::lower_bound(points.begin(), points.end(), x, [=](const QPoint& p, int v) {
+        return p.x() < v;
+    }) - points.begin());
+}
+
+/// 第一个 x > 指定值的点的下标（点按X递增）
+inline int upperBoundX(const QList<QPoint>& points, int x)
+{
+    return int(std::upper_bound(points.begin(), points.end(), x, [=](int v, const QPoint& p) {
+        return v < p.x();
+    }) - points.begin());
+}
+
+#endif // POINTSEARCH_H
@@ -0,0 +1,252 @@
+#include "rangeindex.h"
+#include <limits>
+
+void RangeIndex::build(const QList<QPoint> &points)
+{
+    values.clear();
+    values.reserve(points.size());
+    for (const QPoint& p: points)
+        values.append(p.y());
+    offset = 0;
+    int cap = 16;
+    while (cap < values.size() * 2)
+        cap <<= 1;
+    rebuild(cap);
+}
+
+/// 从连续的Y数组建立（调用者持有的外部数组）
+void RangeIndex::build(const int *ys, int size)
+{
+    values.clear();
+    values.reserve(size);
+    for (int i = 0; i < size; i++)
+        values.append(ys[i]);
+    offset = 0;
+    int cap = 16;
+    while (cap < values.size() * 2)
+        cap <<= 1;
+    rebuild(cap);
+}
+
+void RangeIndex::append(int y)
+{
+    if (count >= capacity)
+    {
+        // 满了：先丢掉已删除的部分，再保证至少一半的空余
+        int cap = qMax(capacity, 16);
+        while (cap < (count - offset + 1) * 2)
+            cap <<= 1;
+        rebuild(cap);
+    }
+
+    values.append(y);
+    prefix.append(prefix.last() + y);
+    int i = capacity + count;
+    minTree[i] = maxTree[i] = y;
+    for (i >>= 1; i >= 1; i >>= 1)
+    {
+        minTree[i] = qMin(minTree[i * 2], minTree[i * 2 + 1]);
+        maxTree[i] = qMax(maxTree[i * 2], maxTree[i * 2 + 1]);
+    }
+    count++;
+}
+
+void RangeIndex::removeFirst()
+{
+    if (offset >= count)
+        return ;
+    offset++;
+    if (offset == count)
+        clear();
+    else if (offset > 1024 && offset * 2 > count) // 删除的太多了，回收内存
+        rebuild(capacity);
+}
+
+/// 只保留前 size 个，之后继续 append（在尾部附近插入时只需重新添加后面的部分）
+/// 线段树中多出的叶子不会被任何 [l, r] 查询完整覆盖，不需要清除
+void RangeIndex::truncate(int size)
+{
+    if (size >= this->size())
+        return ;
+    if (size <= 0)
+    {
+        clear();
+        return ;
+    }
+    count = offset + size;
+    values.resize(count);
+    prefix.resize(count + 1);
+}
+
+void RangeIndex::clear()
+{
+    offset = count = capacity = 0;
+    values.clear();
+    prefix.clear();
+    minTree.clear();
+    maxTree.clear();
+}
+
+int RangeIndex::size() const
+{
+    return count - offset;
+}
+
+/// 索引占用的内存（按容量计算）
+qint64 RangeIndex::memoryBytes() const
+{
+    return values.capacity() * qint64(sizeof(int)) + prefix.capacity() * qint64(sizeof(qint64))
+            + (minTree.capacity() + maxTree.capacity()) * qint64(sizeof(int));
+}
+
+qint64 RangeIndex::sum(int l, int r) const
+{
+    Q_ASSERT(l >= 0 && l <= r && r < size());
+    return prefix.at(r + offset + 1) - prefix.at(l + offset);
+}
+
+int RangeIndex::min(int l, int r) const
+{
+    Q_ASSERT(l >= 0 && l <= r && r < size());
+    int result = std::numeric_limits<int>::max();
+    for (l += capacity + offset, r += capacity + offset + 1; l < r; l >>= 1, r >>= 1)
+    {
+        if (l & 1)
+            result = qMin(result, minTree.at(l++));
+        if (r & 1)
+            result = qMin(result, minTree.at(--r));
+    }
+    return result;
+}
+
+int RangeIndex::max(int l, int r) const
+{
+    Q_ASSERT(l >= 0 && l <= r && r < size());
+    int result = std::numeric_limits<int>::min();
+    for (l += capacity + offset, r += capacity + offset + 1; l < r; l >>= 1, r >>= 1)
+    {
+        if (l & 1)
+            result = qMax(result, maxTree.at(l++));
+        if (r & 1)
+            result = qMax(result, maxTree.at(--r));
+    }
+    return result;
+}
+
+RangeStatistics RangeIndex::statistics(int l, int r) const
+{
+    RangeStatistics stat;
+    l = qMax(l, 0);
+    r = qMin(r, size() - 1);
+    if (l > r)
+        return stat;
+    stat.count = r - l + 1;
+    stat.min = min(l, r);
+    stat.max = max(l, r);
+    stat.sum = sum(l, r);
+    stat.mean = double(stat.sum) / stat.count;
+    return stat;
+}
+
+/// 丢弃已删除的头部，并以指定叶子数量重建线段树
+void RangeIndex::rebuild(int cap)
+{
+    if (offset)
+    {
+        values.remove(0, offset);
+        offset = 0;
+    }
+    count = values.size();
+    capacity = cap;
+    Q_ASSERT(capacity >= count);
+
+    prefix.resize(count + 1);
+    prefix[0] = 0;
+    for (int i = 0; i < count; i++)
+        prefix[i + 1] = prefix.at(i) + values.at(i);
+
+    minTree.fill(std::numeric_limits<int>::max(), capacity * 2);
+    maxTree.fill(std::numeric_limits<int>::min(), capacity * 2);
+    for (int i = 0; i < count; i++)
+        minTree[capacity + i] = maxTree[capacity + i] = values.at(i);
+    for (int i = capacity - 1; i >= 1; i--)
+    {
+        minTree[i] = qMin(minTree.at(i * 2), minTree.at(i * 2 + 1));
+        maxTree[i] = qMax(maxTree.at(i * 2), maxTree.at(i * 2 + 1));
+    }
+}
+
+void SummaryIndex::append(int min, int max, qint64 sum, int count)
+{
+    if (sums.isEmpty())
+    {
+        sums.append(0);
+        counts.append(0);
+    }
+    lows.append(min);
+    highs.append(max);
+    sums.append(sums.last() + sum);
+    counts.append(counts.last() + count);
+}
+
+/// 删除最早的一组；删除的太多时丢掉前缀和的头部（差值不变），回收内存
+void SummaryIndex::removeFirst()
+{
+    if (!size())
+        return ;
+    lows.removeFirst();
+    highs.removeFirst();
+    removed++;
+    if (removed > 1024 && removed * 2 > sums.size())
+    {
+        sums.remove(0, removed);
+        counts.remove(0, removed);
+        removed = 0;
+    }
+}
+
+/// 只保留前 size 组（修改了最后几组时，截断后重新添加）
+void SummaryIndex::truncate(int size)
+{
+    if (size >= this->size())
+        return ;
+    size = qMax(size, 0);
+    lows.truncate(size);
+    highs.truncate(size);
+    sums.resize(removed + size + 1);
+    counts.resize(removed + size + 1);
+}
+
+void SummaryIndex::clear()
+{
+    lows.clear();
+    highs.clear();
+    sums.clear();
+    counts.clear();
+    removed = 0;
+}
+
+int SummaryIndex::size() const
+{
+    return lows.size();
+}
+
+qint64 SummaryIndex::memoryBytes() const
+{
+    return lows.memoryBytes() + highs.memoryBytes() + (sums.capacity() + counts.capacity()) * qint64(sizeof(qint64));
+}
+
+RangeStatistics SummaryIndex::statistics(int l, int r) const
+{
+    RangeStatistics stat;
+    l = qMax(l, 0);
+    r = qMin(r, size() - 1);
+    if (l > r)
+        return stat;
+    stat.count = int(counts.at(removed + r + 1) - counts.at(removed + l));
+    stat.min = lows.min(l, r);
+    stat.max = highs.max(l, r);
+    stat.sum = sums.at(removed + r + 1) - sums.at(removed + l);
+    stat.mean = stat.count ? double(stat.sum) / stat.count : 0;
+    return stat;
+}
@@ -0,0 +1,91 @@
+#ifndef RANGEINDEX_H
+#define RANGEINDEX_H
+
+#include <QList>
+#include <QPoint>
+#include <QVector>
+
+/// 一段区间内的统计结果
+struct RangeStatistics
+{
+    int count = 0;
+    int min = 0;
+    int max = 0;
+    qint64 sum = 0;
+    double mean = 0;
+    bool exact = true;  // 部分数据尚未从磁盘载入、或与汇总的桶部分相交时，以整块（整个桶）的汇总近似
+
+    /// 合并另一段的统计结果
+    void merge(const RangeStatistics& other)
+    {
+        exact = exact && other.exact;
+        if (!other.count)
+            return ;
+        min = count ? qMin(min, other.min) : other.min;
+        max = count ? qMax(max, other.max) : other.max;
+        count += other.count;
+        sum += other.sum;
+        mean = double(sum) / count;
+    }
+};
+
+/**
+ * 折线Y值的区间统计索引
+ * 前缀和求区间和，线段树求区间最值
+ * 追加为 O(log n)，查询为 O(log n)
+ * 删除头部只移动偏移量，删除过多时再整体重建
+ */
+class RangeIndex
+{
+public:
+    void build(const QList<QPoint>& points);
+    void build(const int* ys, int size);
+    void append(int y);
+    void removeFirst();
+    void truncate(int size);
+    void clear();
+    int size() const;
+    qint64 memoryBytes() const;
+
+    // 以下下标均为当前数据中的下标，[l, r] 闭区间
+    qint64 sum(int l, int r) const;
+    int min(int l, int r) const;
+    int max(int l, int r) const;
+    RangeStatistics statistics(int l, int r) const;
+
+private:
+    void rebuild(int cap);
+
+private:
+    int offset = 0;                         // 已删除的头部数量
+    int count = 0;                          // 包括已删除部分的数量
+    int capacity = 0;                       // 线段树叶子数量（2的幂）
+    QVector<int> values;                    // 原始数值（包括已删除部分）
+    QVector<qint64> prefix;                 // prefix[i] = values[0, i) 的和
+    QVector<int> minTree, maxTree;          // 自底向上的线段树，叶子从 capacity 开始
+};
+
+/**
+ * 分组（压缩块、汇总的桶）的区间统计索引：每组的最小值、最大值、和与数量
+ * 最值为两个 RangeIndex，和与数量为前缀和（包括已删除的头部）
+ * 追加、删除头部、截断尾部与查询均为 O(log n)
+ */
+class SummaryIndex
+{
+public:
+    void append(int min, int max, qint64 sum, int count);
+    void removeFirst();
+    void truncate(int size);
+    void clear();
+    int size() const;
+    qint64 memoryBytes() const;
+
+    RangeStatistics statistics(int l, int r) const; // 第 [l, r] 组
+
+private:
+    RangeIndex lows, highs;                 // 每组的最小值、最大值
+    QVector<qint64> sums, counts;           // 前缀和，sums[i] 为前 i 组（包括已删除的头部）的和
+    int removed = 0;                        // 已删除的头部数量
+};
+
+#endif // RANGEINDEX_H
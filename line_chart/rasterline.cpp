@@ -0,0 +1,148 @@
+#include "rasterline.h"
+
+void RasterLine::drawPolyline(QImage &image, const QList<QPoint> &points, QColor color, QPoint offset, qreal scale)
+{
+    if (points.size() < 2 || image.isNull())
+        return ;
+    Q_ASSERT(image.format() == QImage::Format_ARGB32_Premultiplied);
+    QRgb rgb = qPremultiply(color.rgba());
+    QRgb* bits = reinterpret_cast<QRgb*>(image.bits());
+    int stride = image.bytesPerLine() / int(sizeof(QRgb));
+    int w = image.width(), h = image.height();
+
+    int px = qRound((points.first().x() + offset.x()) * scale);
+    int py = qRound((points.first().y() + offset.y()) * scale);
+    for (int i = 1; i < points.size(); i++)
+    {
+        int x = qRound((points.at(i).x() + offset.x()) * scale);
+        int y = qRound((points.at(i).y() + offset.y()) * scale);
+        if (x == px && y == py && i > 1) // 密集的点落在同一像素
+            continue;
+        plotLine(bits, stride, w, h, px, py, x, y, rgb, i > 1); // 相邻两段共用的端点只画一次，半透明时不会叠加
+        px = x;
+        py = y;
+    }
+}
+
+void RasterLine::drawLine(QImage &image, int x0, int y0, int x1, int y1, QRgb color)
+{
+    if (image.isNull())
+        return ;
+    Q_ASSERT(image.format() == QImage::Format_ARGB32_Premultiplied);
+    plotLine(reinterpret_cast<QRgb*>(image.bits()), image.bytesPerLine() / int(sizeof(QRgb)),
+             image.width(), image.height(), x0, y0, x1, y1, qPremultiply(color));
+}
+
+/// Bresenham 直线，color 为预乘后的颜色；skipFirst 为true时不画起点（上一段的终点）
+void RasterLine::plotLine(QRgb *bits, int stride, int w, int h, int x0, int y0, int x1, int y1, QRgb color, bool skipFirst)
+{
+    const int startX = x0, startY = y0;
+    if (!clipLine(x0, y0, x1, y1, w, h))
+        return ;
+    bool skip = skipFirst && x0 == startX && y0 == startY; // 起点被裁剪时不是共用的端点
+
+    const int alpha = qAlpha(color);
+    const int dx = qAbs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    const int dy = -qAbs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    while (true)
+    {
+        QRgb& dst = bits[y0 * stride + x0];
+        if (skip)
+        {
+            skip = false;
+        }
+        else if (alpha == 255)
+        {
+            dst = color;
+        }
+        else // 预乘格式下的 source-over
+        {
+            const int inv = 255 - alpha;
+            dst = qRgba(qRed(color) + qRed(dst) * inv / 255,
+                        qGreen(color) + qGreen(dst) * inv / 255,
+                        qBlue(color) + qBlue(dst) * inv / 255,
+                        alpha + qAlpha(dst) * inv / 255);
+        }
+
+        if (x0 == x1 && y0 == y1)
+            break;
+        int e2 = err * 2;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+/// Cohen-Sutherland 裁剪到 [0, w) x [0, h)，完全在外面则返回false
+bool RasterLine::clipLine(int &x0, int &y0, int &x1, int &y1, int w, int h)
+{
+    enum { Left = 1, Right = 2, Top = 4, Bottom = 8 };
+    const int xMax = w - 1, yMax = h - 1;
+    if (xMax < 0 || yMax < 0)
+        return false;
+    auto code = [=](int x, int y) {
+        int c = 0;
+        if (x < 0)
+            c |= Left;
+        else if (x > xMax)
+            c |= Right;
+        if (y < 0)
+            c |= Top;
+        else if (y > yMax)
+            c |= Bottom;
+        return c;
+    };
+
+    int c0 = code(x0, y0), c1 = code(x1, y1);
+    while (true)
+    {
+        if (!(c0 | c1))
+            return true;
+        if (c0 & c1)
+            return false;
+
+        int c = c0 ? c0 : c1;
+        double x = 0, y = 0;
+        if (c & Bottom)
+        {
+            x = x0 + (x1 - x0) * double(yMax - y0) / (y1 - y0);
+            y = yMax;
+        }
+        else if (c & Top)
+        {
+            x = x0 + (x1 - x0) * double(0 - y0) / (y1 - y0);
+            y = 0;
+        }
+        else if (c & Right)
+        {
+            y = y0 + (y1 - y0) * double(xMax - x0) / (x1 - x0);
+            x = xMax;
+        }
+        else // Left
+        {
+            y = y0 + (y1 - y0) * double(0 - x0) / (x1 - x0);
+            x = 0;
+        }
+
+        if (c == c0)
+        {
+            x0 = qRound(x);
+            y0 = qRound(y);
+            c0 = code(x0, y0);
+        }
+        else
+        {
+            x1 = qRound(x);
+            y1 = qRound(y);
+            c1 = code(x1, y1);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef RASTERLINE_H
+#define RASTERLINE_H
+
+#include <QImage>
+#include <QList>
+#include <QPoint>
+#include <QColor>
+
+/**
+ * 直接写入 QImage 扫描行的折线绘制（无抗锯齿）
+ * 点数非常多时绕过 QPainterPath 的描边，用整数 Bresenham 算法逐像素写入
+ * 图片格式要求为 Format_ARGB32_Premultiplied
+ */
+class RasterLine
+{
+public:
+    static void drawPolyline(QImage& image, const QList<QPoint>& points, QColor color, QPoint offset = QPoint(), qreal scale = 1);
+    static void drawLine(QImage& image, int x0, int y0, int x1, int y1, QRgb color);
+
+private:
+    static void plotLine(QRgb* bits, int stride, int w, int h, int x0, int y0, int x1, int y1, QRgb color, bool skipFirst = false);
+    static bool clipLine(int& x0, int& y0, int& x1, int& y1, int w, int h);
+};
+
+#endif // RASTERLINE_H
@@ -0,0 +1,660 @@
+#include "serieshistory.h"
+#include "chunkstore.h"
+#include "pointsearch.h"
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <algorithm>
+
+namespace
+{
+QAtomicInteger<quint64> nextChunkId(1);
+
+inline quint64 zigzag(qint64 v)
+{
+    return (quint64(v) << 1) ^ quint64(v >> 63);
+}
+
+inline qint64 unzigzag(quint64 v)
+{
+    return qint64(v >> 1) ^ -qint64(v & 1);
+}
+
+inline void writeVarint(QByteArray& bytes, quint64 v)
+{
+    while (v >= 0x80)
+    {
+        bytes.append(char((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    bytes.append(char(v));
+}
+
+inline quint64 readVarint(const uchar*& p)
+{
+    quint64 v = 0;
+    int shift = 0;
+    while (*p & 0x80)
+    {
+        v |= quint64(*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    v |= quint64(*p++) << shift;
+    return v;
+}
+}
+
+SeriesHistory::SeriesHistory() : cache(new DecodeCache)
+{
+    cache->chunks.setMaxCost(16);
+}
+
+/// 封存一段点（X必须不小于已有的点）
+void SeriesHistory::append(const QList<QPoint> &points)
+{
+    if (points.empty())
+        return ;
+    Q_ASSERT(chunks.empty() || points.first().x() >= chunks.last().xLast);
+
+    SeriesChunk chunk = makeChunk(points);
+    compressedBytes += chunk.bytes.size();
+    this->points += chunk.count;
+    chunks.append(chunk);
+    index.append(chunk.yMin, chunk.yMax, chunk.ySum, chunk.count);
+}
+
+/// 把迟到的点插入所在的块：解码、插入、重新编码，换一个新的编号（快照中的旧块不受影响）
+/// 早于现存的第一个点，或者所在的块已经换出到磁盘时不插入，返回false
+bool SeriesHistory::insert(const QPoint &p)
+{
+    if (chunks.empty() || p.x() < chunks.first().xFirst)
+        return false;
+    const int c = qMin(chunkIndexOfX(p.x()), chunks.size() - 1);
+    SeriesChunk& chunk = chunks[c];
+    if (chunk.spillHandle >= 0)
+        return false;
+
+    QList<QPoint> list = decoded(chunk);
+    list.erase(list.begin(), list.begin() + chunk.skip);
+    list.insert(upperBoundX(list, p.x()), p);
+    cache->chunks.remove(chunk.id);
+    compressedBytes -= chunk.bytes.size();
+    chunk = makeChunk(list);
+    compressedBytes += chunk.bytes.size();
+    points++;
+    reindexFrom(c);
+    return true;
+}
+
+/// 移除最早的一个点，只记录跳过的数量，整块都被移除时才释放
+void SeriesHistory::removeFirst()
+{
+    if (chunks.empty())
+        return ;
+    SeriesChunk& chunk = chunks.first();
+    chunk.skip++;
+    points--;
+    if (chunk.skip >= chunk.count)
+    {
+        dropFirstChunk();
+    }
+    else
+    {
+        // 只更新记录的X，用完后才解码补充；换出到磁盘的块只异步载入，xFirst 暂时作为下界
+        if (!chunk.heads.isEmpty())
+            chunk.heads.removeFirst();
+        if (chunk.heads.isEmpty() && !refillHeads(chunk))
+            return ;
+        chunk.xFirst = chunk.heads.first();
+    }
+}
+
+/// 移除X小于 x 的最早的点，out 不为空时按先后追加到其中；返回移除的数量，firstX 为其中第一个点的X
+/// 需要取出点时，换出到磁盘且尚未载入的块停在那里并发起异步载入，载入后再继续
+/// 不需要取出点时整块移除不用解码，包括换出到磁盘的块
+int SeriesHistory::takeBefore(int x, QList<QPoint> *out, int &firstX)
+{
+    int count = 0;
+    while (!chunks.empty())
+    {
+        SeriesChunk& chunk = chunks.first();
+        const int remain = chunk.count - chunk.skip;
+        QList<QPoint> list;
+        if (chunk.xLast < x && !out) // 整块移除
+        {
+            if (!count)
+                headX(0, firstX);
+            count += remain;
+            points -= remain;
+            dropFirstChunk();
+            continue;
+        }
+        if (!tryDecoded(chunk, list))
+            break;
+
+        const int end = qMin(lowerBoundX(list, x), list.size());
+        if (end <= chunk.skip)
+            break;
+        if (!count)
+            firstX = list.at(chunk.skip).x();
+        if (out)
+            for (int i = chunk.skip; i < end; i++)
+                out->append(list.at(i));
+        count += end - chunk.skip;
+        points -= end - chunk.skip;
+        if (end >= chunk.count)
+        {
+            dropFirstChunk();
+            continue;
+        }
+        chunk.skip = end;
+        chunk.xFirst = list.at(end).x();
+        chunk.heads.clear();
+        for (int i = end; i < list.size() && chunk.heads.size() < HeadCount; i++)
+            chunk.heads.append(list.at(i).x());
+        break;
+    }
+    return count;
+}
+
+void SeriesHistory::clear()
+{
+    for (const SeriesChunk& chunk: chunks)
+    {
+        cache->chunks.remove(chunk.id);
+        if (chunk.spillHandle >= 0)
+            store->release(chunk.spillHandle);
+    }
+    chunks.clear();
+    index.clear();
+    points = 0;
+    compressedBytes = 0;
+    spilledBytes = 0;
+    firstResident = 0;
+}
+
+bool SeriesHistory::isEmpty() const
+{
+    return chunks.empty();
+}
+
+qint64 SeriesHistory::pointCount() const
+{
+    return points;
+}
+
+/// 最早的点的X，不确定时（见 isFirstXExact）为下界
+int SeriesHistory::firstX() const
+{
+    Q_ASSERT(!chunks.empty());
+    int x = chunks.first().xFirst;
+    headX(0, x);
+    return x;
+}
+
+/// 最早的点的X是否确定：换出到磁盘的块移除了超过 HeadCount 个点后，载入前只知道下界
+bool SeriesHistory::isFirstXExact() const
+{
+    Q_ASSERT(!chunks.empty());
+    const SeriesChunk& chunk = chunks.first();
+    return !chunk.skip || !chunk.heads.isEmpty() || chunk.spillHandle < 0 || cache->chunks.contains(chunk.id);
+}
+
+int SeriesHistory::lastX() const
+{
+    Q_ASSERT(!chunks.empty());
+    return chunks.last().xLast;
+}
+
+/// 第k个（从0开始）剩余点的X，优先使用块中记录的X，不会同步读取磁盘
+/// 所在的块换出到磁盘且尚未载入时发起异步载入，暂时以块的 xFirst 作为下界
+bool SeriesHistory::headX(int k, int &x) const
+{
+    for (const SeriesChunk& chunk: chunks)
+    {
+        int remain = chunk.count - chunk.skip;
+        if (k < remain)
+        {
+            QList<QPoint> list;
+            if (k < chunk.heads.size())
+                x = chunk.heads.at(k);
+            else if (tryDecoded(chunk, list))
+                x = list.at(chunk.skip + k).x();
+            else
+                x = chunk.xFirst;
+            return true;
+        }
+        k -= remain;
+    }
+    return false;
+}
+
+/// 编号为 id 的块剩余部分的X范围，没有这个块时返回false
+bool SeriesHistory::chunkRange(quint64 id, int &xFrom, int &xTo) const
+{
+    for (const SeriesChunk& chunk: chunks)
+    {
+        if (chunk.id != id)
+            continue;
+        xFrom = chunk.xFirst;
+        xTo = chunk.xLast;
+        return true;
+    }
+    return false;
+}
+
+/// 取出X在 [xFrom, xTo] 内的点，以及两侧各 extra 个点（若有），追加到 out
+/// 换出到磁盘的块会异步载入，载入前跳过，并把其X范围追加到 missing
+/// resolution 为一个像素列对应的X跨度：X跨度小于它的块以汇总的最小值与最大值代替，不解码也不需要载入
+void SeriesHistory::collect(int xFrom, int xTo, int extra, QList<QPoint> &out, QList<QPair<int, int>>* missing,
+                            int resolution) const
+{
+    if (chunks.empty())
+        return ;
+    int c0 = chunkIndexOfX(xFrom), c1 = c0;
+    while (c1 < chunks.size() && chunks.at(c1).xFirst <= xTo)
+        c1++;
+    // 相邻的块也解码，保证两侧的 extra 个点
+    c0 = qMax(c0 - 1, 0);
+    c1 = qMin(c1 + 1, chunks.size());
+    auto summarized = [=](const SeriesChunk& chunk) { // 头部移除过的块，汇总中包括已移除的点
+        return !chunk.skip && qint64(chunk.xLast) - chunk.xFirst < resolution;
+    };
+
+    QList<QPoint> range;
+    for (int c = c0; c < c1; c++)
+    {
+        const SeriesChunk& chunk = chunks.at(c);
+        if (summarized(chunk))
+        {
+            appendSummary(chunk, range);
+            continue;
+        }
+        QList<QPoint> list;
+        if (!tryDecoded(chunk, list))
+        {
+            if (missing)
+                missing->append(qMakePair(chunk.xFirst, chunk.xLast));
+            continue;
+        }
+        for (int i = chunk.skip; i < list.size(); i++)
+            range.append(list.at(i));
+    }
+
+    // 预先载入视图两侧相邻的块
+    if (c0 > 0 && !summarized(chunks.at(c0 - 1)))
+        requestLoad(chunks.at(c0 - 1));
+    if (c1 < chunks.size() && !summarized(chunks.at(c1)))
+        requestLoad(chunks.at(c1));
+
+    int l = qMax(lowerBoundX(range, xFrom) - extra, 0);
+    int r = qMin(upperBoundX(range, xTo) + extra, range.size());
+    for (int i = l; i < r; i++)
+        out.append(range.at(i));
+}
+
+/// X在 [xFrom, xTo] 内的统计：完整包含的块（连续的一段）用块汇总的索引查询，只有两端部分相交的块需要解码
+RangeStatistics SeriesHistory::statistics(int xFrom, int xTo) const
+{
+    RangeStatistics stat;
+    // 完整包含的块为 [l, r]；头部移除过的块汇总中包括已移除的点，不算在内
+    int l = int(std::lower_bound(chunks.begin(), chunks.end(), xFrom, [](const SeriesChunk& chunk, int v) {
+        return chunk.xFirst < v;
+    }) - chunks.begin());
+    const int r = int(std::upper_bound(chunks.begin(), chunks.end(), xTo, [](int v, const SeriesChunk& chunk) {
+        return v < chunk.xLast;
+    }) - chunks.begin()) - 1;
+    if (l == 0 && !chunks.empty() && chunks.first().skip)
+        l = 1;
+    if (l <= r)
+        stat.merge(index.statistics(l, r));
+
+    for (int c = chunkIndexOfX(xFrom); c < chunks.size() && chunks.at(c).xFirst <= xTo; c++)
+    {
+        if (c >= l && c <= r)
+        {
+            c = r; // 已经统计过
+            continue;
+        }
+        const SeriesChunk& chunk = chunks.at(c);
+
+        QList<QPoint> list;
+        if (!tryDecoded(chunk, list)) // 还在磁盘上，先用整块的汇总近似
+        {
+            RangeStatistics part;
+            part.count = chunk.count - chunk.skip;
+            part.min = chunk.yMin;
+            part.max = chunk.yMax;
+            part.sum = chunk.ySum;
+            part.exact = false;
+            stat.merge(part);
+            continue;
+        }
+        for (int i = chunk.skip; i < list.size(); i++)
+        {
+            const QPoint& p = list.at(i);
+            if (p.x() < xFrom || p.x() > xTo)
+                continue;
+            RangeStatistics part;
+            part.count = 1;
+            part.min = part.max = p.y();
+            part.sum = p.y();
+            stat.merge(part);
+        }
+    }
+    return stat;
+}
+
+/// 解码缓存最多保留多少块
+void SeriesHistory::setCacheLimit(int chunks)
+{
+    cache->chunks.setMaxCost(qMax(chunks, 1));
+}
+
+HistoryStatistics SeriesHistory::getStatistics() const
+{
+    HistoryStatistics stat;
+    stat.chunkCount = chunks.size();
+    stat.pointCount = points;
+    for (const SeriesChunk& chunk: chunks)
+        stat.rawBytes += qint64(chunk.count - chunk.skip) * qint64(sizeof(QPoint));
+    stat.compressedBytes = compressedBytes;
+    stat.compressionRatio = compressedBytes ? double(stat.rawBytes) / compressedBytes : 0;
+    stat.decodeCount = cache->decodeCount;
+    stat.decodeTime = cache->decodeNanos / 1e6;
+    stat.spilledChunks = firstResident;
+    stat.spilledBytes = spilledBytes;
+    return stat;
+}
+
+/// 在内存中占用的大小：压缩数据、块信息与索引、已解码缓存的块
+qint64 SeriesHistory::memoryBytes() const
+{
+    qint64 bytes = residentBytes() + chunks.size() * qint64(sizeof(SeriesChunk)) + index.memoryBytes();
+    for (const SeriesChunk& chunk: chunks)
+    {
+        bytes += chunk.heads.capacity() * qint64(sizeof(int));
+        if (cache->chunks.contains(chunk.id))
+            bytes += chunk.count * qint64(sizeof(QPoint));
+    }
+    return bytes;
+}
+
+/// 写入快照：每个块的汇总与压缩后的数据，换出到磁盘的块从 spill 中读取
+/// 只读取自身的拷贝，可以在其他线程中调用
+bool SeriesHistory::save(QDataStream &out, const ChunkStoreView *spill) const
+{
+    out << quint32(chunks.size());
+    for (const SeriesChunk& chunk: chunks)
+    {
+        QByteArray bytes = chunk.bytes;
+        if (chunk.spillHandle >= 0)
+        {
+            if (!spill)
+                return false;
+            bytes = spill->read(chunk.spillHandle);
+            if (bytes.size() != chunk.fileSize)
+                return false;
+        }
+        out << chunk.count << chunk.skip << chunk.xFirst << chunk.xLast
+            << chunk.yMin << chunk.yMax << chunk.yMinX << chunk.yMaxX << chunk.ySum << bytes;
+    }
+    return out.status() == QDataStream::Ok;
+}
+
+/// 从快照中读取，替换现有的块（全部放在内存中）
+bool SeriesHistory::load(QDataStream &in)
+{
+    clear();
+    quint32 count = 0;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+    {
+        SeriesChunk chunk;
+        chunk.id = nextChunkId.fetchAndAddRelaxed(1);
+        in >> chunk.count >> chunk.skip >> chunk.xFirst >> chunk.xLast
+           >> chunk.yMin >> chunk.yMax >> chunk.yMinX >> chunk.yMaxX >> chunk.ySum >> chunk.bytes;
+        if (chunk.skip < 0 || chunk.skip >= chunk.count)
+            in.setStatus(QDataStream::ReadCorruptData);
+        points += chunk.count - chunk.skip;
+        compressedBytes += chunk.bytes.size();
+        chunks.append(chunk);
+        index.append(chunk.yMin, chunk.yMax, chunk.ySum, chunk.count);
+    }
+    if (in.status() != QDataStream::Ok)
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+/// 设置换出到磁盘的目标，为空则不换出
+void SeriesHistory::setStore(ChunkStore *store)
+{
+    this->store = store;
+}
+
+/// 在内存中的压缩数据大小
+qint64 SeriesHistory::residentBytes() const
+{
+    return compressedBytes - spilledBytes;
+}
+
+/// 把最早的一个还在内存中的块换出到磁盘（ChunkStore 在后台写入，不阻塞）
+bool SeriesHistory::spillOldest()
+{
+    if (!store || firstResident >= chunks.size())
+        return false;
+    SeriesChunk& chunk = chunks[firstResident];
+    qint64 handle = store->write(chunk.bytes);
+    if (handle < 0)
+        return false;
+    chunk.spillHandle = handle;
+    chunk.fileSize = chunk.bytes.size();
+    chunk.bytes = QByteArray();
+    spilledBytes += chunk.fileSize;
+    firstResident++;
+    return true;
+}
+
+/// 第一个点原样保存，之后 X 保存二阶差分、Y 保存一阶差分
+QByteArray SeriesHistory::encode(const QList<QPoint> &points)
+{
+    QByteArray bytes;
+    bytes.reserve(points.size() * 2 + 16);
+    qint64 prevX = 0, prevDelta = 0, prevY = 0;
+    for (int i = 0; i < points.size(); i++)
+    {
+        const qint64 x = points.at(i).x(), y = points.at(i).y();
+        if (i == 0)
+        {
+            writeVarint(bytes, zigzag(x));
+            writeVarint(bytes, zigzag(y));
+        }
+        else
+        {
+            const qint64 delta = x - prevX;
+            writeVarint(bytes, zigzag(delta - prevDelta));
+            writeVarint(bytes, zigzag(y - prevY));
+            prevDelta = delta;
+        }
+        prevX = x;
+        prevY = y;
+    }
+    bytes.squeeze();
+    return bytes;
+}
+
+void SeriesHistory::decode(const QByteArray &bytes, int count, QList<QPoint> &out)
+{
+    out.reserve(out.size() + count);
+    const uchar* p = reinterpret_cast<const uchar*>(bytes.constData());
+    qint64 x = 0, y = 0, delta = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (i == 0)
+        {
+            x = unzigzag(readVarint(p));
+            y = unzigzag(readVarint(p));
+        }
+        else
+        {
+            delta += unzigzag(readVarint(p));
+            x += delta;
+            y += unzigzag(readVarint(p));
+        }
+        out.append(QPoint(int(x), int(y)));
+    }
+}
+
+/// 压缩一段点，并计算块的汇总
+SeriesChunk SeriesHistory::makeChunk(const QList<QPoint> &points)
+{
+    SeriesChunk chunk;
+    chunk.id = nextChunkId.fetchAndAddRelaxed(1);
+    chunk.count = points.size();
+    chunk.xFirst = points.first().x();
+    chunk.xLast = points.last().x();
+    chunk.yMin = chunk.yMax = points.first().y();
+    chunk.yMinX = chunk.yMaxX = points.first().x();
+    for (const QPoint& p: points)
+    {
+        if (p.y() < chunk.yMin) // 相同时保留较早的
+        {
+            chunk.yMin = p.y();
+            chunk.yMinX = p.x();
+        }
+        if (p.y() > chunk.yMax)
+        {
+            chunk.yMax = p.y();
+            chunk.yMaxX = p.x();
+        }
+        chunk.ySum += p.y();
+    }
+    for (int i = 0; i < points.size() && i < HeadCount; i++)
+        chunk.heads.append(points.at(i).x());
+    chunk.bytes = encode(points);
+    return chunk;
+}
+
+/// 以汇总代替块中的点：最小值与最大值所在的两个点（按X先后），是同一个点时只有一个
+void SeriesHistory::appendSummary(const SeriesChunk &chunk, QList<QPoint> &out)
+{
+    const QPoint low(chunk.yMinX, chunk.yMin), high(chunk.yMaxX, chunk.yMax);
+    if (low == high)
+    {
+        out.append(low);
+    }
+    else if (low.x() <= high.x())
+    {
+        out.append(low);
+        out.append(high);
+    }
+    else
+    {
+        out.append(high);
+        out.append(low);
+    }
+}
+
+/// 第 c 个块被替换后，重新添加它及之后的块的汇总
+void SeriesHistory::reindexFrom(int c)
+{
+    index.truncate(c);
+    for (int i = c; i < chunks.size(); i++)
+        index.append(chunks.at(i).yMin, chunks.at(i).yMax, chunks.at(i).ySum, chunks.at(i).count);
+}
+
+/// 释放第一个块（内存中的数据或磁盘上的位置），点的数量由调用者更新
+void SeriesHistory::dropFirstChunk()
+{
+    const SeriesChunk& chunk = chunks.first();
+    if (chunk.spillHandle >= 0)
+    {
+        compressedBytes -= chunk.fileSize;
+        spilledBytes -= chunk.fileSize;
+        store->release(chunk.spillHandle);
+    }
+    else
+    {
+        compressedBytes -= chunk.bytes.size();
+    }
+    cache->chunks.remove(chunk.id);
+    chunks.removeFirst();
+    index.removeFirst();
+    firstResident = qMax(firstResident - 1, 0);
+}
+
+/// 补充块剩余的前几个点的X；换出到磁盘且尚未载入时只发起异步载入，返回false
+bool SeriesHistory::refillHeads(SeriesChunk &chunk) const
+{
+    QList<QPoint> list;
+    if (!tryDecoded(chunk, list))
+        return false;
+    chunk.heads.clear();
+    for (int i = chunk.skip; i < list.size() && chunk.heads.size() < HeadCount; i++)
+        chunk.heads.append(list.at(i).x());
+    return true;
+}
+
+/// 从缓存中取出解码后的块，没有则解码并放入缓存
+/// 换出到磁盘的块必须已经载入到缓存中（见 tryDecoded），这里不读取磁盘
+QList<QPoint> SeriesHistory::decoded(const SeriesChunk &chunk) const
+{
+    if (QList<QPoint>* list = cache->chunks.object(chunk.id))
+        return *list;
+
+    Q_ASSERT(chunk.spillHandle < 0);
+    QElapsedTimer timer;
+    timer.start();
+    QList<QPoint>* list = new QList<QPoint>();
+    decode(chunk.bytes, chunk.count, *list);
+    cache->decodeNanos += timer.nsecsElapsed();
+    cache->decodeCount++;
+
+    QList<QPoint> result = *list;
+    cache->chunks.insert(chunk.id, list, 1);
+    return result;
+}
+
+/// 不会阻塞的解码：在缓存或内存中则返回true，否则发起异步载入并返回false
+bool SeriesHistory::tryDecoded(const SeriesChunk &chunk, QList<QPoint> &out) const
+{
+    if (chunk.spillHandle >= 0 && !cache->chunks.contains(chunk.id))
+    {
+        requestLoad(chunk);
+        return false;
+    }
+    out = decoded(chunk);
+    return true;
+}
+
+/// 异步载入换出到磁盘的块，完成后解码并放入缓存
+void SeriesHistory::requestLoad(const SeriesChunk &chunk) const
+{
+    if (chunk.spillHandle < 0 || !store || cache->chunks.contains(chunk.id))
+        return ;
+    QWeakPointer<DecodeCache> weak = cache;
+    const quint64 id = chunk.id;
+    const int count = chunk.count;
+    store->requestLoad(id, chunk.spillHandle, [=](const QByteArray& bytes) {
+        QSharedPointer<DecodeCache> cache = weak.toStrongRef();
+        if (!cache)
+            return ;
+        QElapsedTimer timer;
+        timer.start();
+        QList<QPoint>* list = new QList<QPoint>();
+        decode(bytes, count, *list);
+        cache->decodeNanos += timer.nsecsElapsed();
+        cache->decodeCount++;
+        cache->chunks.insert(id, list, 1);
+    });
+}
+
+/// 第一个 xLast >= x 的块
+int SeriesHistory::chunkIndexOfX(int x) const
+{
+    return int(std::lower_bound(chunks.begin(), chunks.end(), x, [=](const SeriesChunk& chunk, int v) {
+        return chunk.xLast < v;
+    }) - chunks.begin());
+}
@@ -0,0 +1,119 @@
+#ifndef SERIESHISTORY_H
+#define SERIESHISTORY_H
+
+#include <QList>
+#include <QPoint>
+#include <QByteArray>
+#include <QVector>
+#include <QCache>
+#include <QSharedPointer>
+#include <QPair>
+#include <QDataStream>
+#include "rangeindex.h"
+
+class ChunkStore;
+class ChunkStoreView;
+
+/// 封存后压缩的一段连续的点
+struct SeriesChunk
+{
+    quint64 id = 0;                         // 唯一编号，用于解码缓存
+    int count = 0;                          // 点的数量
+    int skip = 0;                           // 头部已经被移除的数量
+    int xFirst = 0, xLast = 0;              // 换出到磁盘且 heads 用完后 xFirst 只是下界
+    QVector<int> heads;                     // 剩余的前几个点的X，移除与查询最早的点时不用读取磁盘
+    int yMin = 0, yMax = 0;
+    int yMinX = 0, yMaxX = 0;               // 最小值、最大值所在的X
+    qint64 ySum = 0;
+    QByteArray bytes;                       // 压缩后的数据，换出到磁盘后为空
+    qint64 spillHandle = -1;                // 换出到磁盘的句柄（见 ChunkStore），-1为在内存中
+    int fileSize = 0;
+};
+
+/// 压缩历史的统计信息
+struct HistoryStatistics
+{
+    int chunkCount = 0;
+    qint64 pointCount = 0;
+    qint64 rawBytes = 0;                    // 未压缩时 QPoint 所占字节
+    qint64 compressedBytes = 0;
+    double compressionRatio = 0;            // rawBytes / compressedBytes
+    int spilledChunks = 0;                  // 换出到磁盘的块数
+    qint64 spilledBytes = 0;
+    qint64 decodeCount = 0;                 // 累计解码的块数
+    double decodeTime = 0;                  // 累计解码耗时(ms)
+};
+
+/**
+ * 折线的压缩历史：按块封存旧的点
+ * X 使用二阶差分（时间间隔大多固定，几乎都是0），Y 使用一阶差分，均为 zigzag + varint 编码
+ * 只有与可见范围或查询相交的块才会被解码，并放入一个小的 LRU 缓存
+ * 区间统计中完整包含的块使用块汇总的索引；显示时不到一个像素列的块以汇总的最值代替，不解码
+ */
+class SeriesHistory
+{
+public:
+    SeriesHistory();
+
+    void append(const QList<QPoint>& points);
+    bool insert(const QPoint& p);
+    void removeFirst();
+    int takeBefore(int x, QList<QPoint>* out, int& firstX);
+    void clear();
+
+    bool isEmpty() const;
+    qint64 pointCount() const;
+    int firstX() const;
+    bool isFirstXExact() const;
+    int lastX() const;
+    bool headX(int k, int& x) const;
+    bool chunkRange(quint64 id, int& xFrom, int& xTo) const;
+    void collect(int xFrom, int xTo, int extra, QList<QPoint>& out, QList<QPair<int, int>>* missing = nullptr,
+                 int resolution = 0) const;
+    RangeStatistics statistics(int xFrom, int xTo) const;
+
+    void setCacheLimit(int chunks);
+    HistoryStatistics getStatistics() const;
+    qint64 memoryBytes() const;
+    bool save(QDataStream& out, const ChunkStoreView* spill) const;
+    bool load(QDataStream& in);
+
+    void setStore(ChunkStore* store);
+    qint64 residentBytes() const;
+    bool spillOldest();
+
+    static QByteArray encode(const QList<QPoint>& points);
+    static void decode(const QByteArray& bytes, int count, QList<QPoint>& out);
+
+private:
+    static SeriesChunk makeChunk(const QList<QPoint>& points);
+    static void appendSummary(const SeriesChunk& chunk, QList<QPoint>& out);
+    void reindexFrom(int c);
+    bool refillHeads(SeriesChunk& chunk) const;
+    void dropFirstChunk();
+    QList<QPoint> decoded(const SeriesChunk& chunk) const;
+    bool tryDecoded(const SeriesChunk& chunk, QList<QPoint>& out) const;
+    void requestLoad(const SeriesChunk& chunk) const;
+    int chunkIndexOfX(int x) const;
+
+private:
+    static const int HeadCount = 8;         // 每个块记录的最早的点的X的数量
+
+    struct DecodeCache
+    {
+        QCache<quint64, QList<QPoint>> chunks;
+        qint64 decodeCount = 0;
+        qint64 decodeNanos = 0;
+    };
+
+    QList<SeriesChunk> chunks;
+    SummaryIndex index;                     // 每个块封存时的汇总，下标与 chunks 一一对应
+    qint64 points = 0;                      // 剩余点的数量
+    qint64 compressedBytes = 0;
+    qint64 spilledBytes = 0;
+    int firstResident = 0;                  // 这之前的块都已经换出到磁盘
+    ChunkStore* store = nullptr;            // 换出的目标，由模型持有
+    QSharedPointer<DecodeCache> cache;      // 拷贝之间共享，块的内容不会变化，编号全局唯一
+};
+
+#endif // SERIESHISTORY_H
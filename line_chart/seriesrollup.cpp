@@ -0,0 +1,382 @@
+#include "seriesrollup.h"
+#include "pointsearch.h"
+#include <algorithm>
+#include <limits>
+
+/// 设置保留策略；已有的桶按先后重新放入新的第一级，之后由 cascade 按新的跨度逐级汇总
+/// 没有任何一级时已有的桶全部丢弃
+void SeriesRollup::setPolicy(const RetentionPolicy &policy)
+{
+    QList<RollupBucket> old;
+    for (int t = buckets.size() - 1; t >= 0; t--)
+        old += buckets.at(t);
+
+    this->policy = policy;
+    this->policy.rawHorizon = qMax(policy.rawHorizon, 0);
+    int horizon = this->policy.rawHorizon;
+    for (RollupTier& tier: this->policy.tiers) // 宽度至少为1，跨度逐级递增
+    {
+        tier.bucket = qMax(tier.bucket, 1);
+        tier.horizon = qMax(tier.horizon, horizon);
+        horizon = tier.horizon;
+    }
+
+    buckets.clear();
+    indexes.clear();
+    points = 0;
+    for (int t = 0; t < this->policy.tiers.size(); t++)
+    {
+        buckets.append(QList<RollupBucket>());
+        indexes.append(SummaryIndex());
+    }
+    if (!buckets.isEmpty())
+        for (const RollupBucket& bucket: old)
+            appendBucket(0, bucket);
+}
+
+const RetentionPolicy &SeriesRollup::getPolicy() const
+{
+    return policy;
+}
+
+bool SeriesRollup::isEnabled() const
+{
+    return policy.isEnabled();
+}
+
+/// 早于这个X的原始点应当汇总（或移除）；有汇总时对齐到第一级的桶，只汇总完整的桶
+int SeriesRollup::rawCutoff(int lastX) const
+{
+    const int cutoff = lastX - policy.rawHorizon;
+    if (policy.tiers.isEmpty())
+        return cutoff;
+    return bucketStart(cutoff, policy.tiers.first().bucket);
+}
+
+/// 原始点（X递增，且不早于已有的桶）汇总到第一级，没有任何一级时忽略
+void SeriesRollup::add(const QList<QPoint> &points)
+{
+    if (buckets.isEmpty())
+        return ;
+    for (const QPoint& p: points)
+    {
+        RollupBucket bucket;
+        bucket.x = p.x();
+        bucket.minX = bucket.maxX = p.x();
+        bucket.minY = bucket.maxY = p.y();
+        bucket.sum = p.y();
+        bucket.count = 1;
+        appendBucket(0, bucket);
+    }
+}
+
+/// 每一级超出跨度的桶汇总到下一级；有变化时返回true
+/// [xFrom, xTo) 为显示的形状发生变化的X范围，xTo 为第一级剩下的第一个点，第一级为空时为 INT_MAX
+bool SeriesRollup::cascade(int lastX, int &xFrom, int &xTo)
+{
+    bool changed = false;
+    for (int t = 0; t + 1 < buckets.size(); t++)
+    {
+        const RollupTier& tier = policy.tiers.at(t);
+        QList<RollupBucket>& list = buckets[t];
+        while (!list.isEmpty() && qint64(list.first().x) + tier.bucket <= qint64(lastX) - tier.horizon)
+        {
+            const RollupBucket bucket = list.first();
+            removeFirstBucket(t);
+            xFrom = changed ? qMin(xFrom, bucket.x) : bucket.x;
+            changed = true;
+            appendBucket(t + 1, bucket);
+        }
+    }
+    if (!changed)
+        return false;
+    xTo = std::numeric_limits<int>::max();
+    if (!buckets.first().isEmpty())
+    {
+        const RollupBucket& bucket = buckets.first().first();
+        xTo = qMin(bucket.minX, bucket.maxX);
+    }
+    return true;
+}
+
+/// 移除最后一级超出跨度的桶，返回移除的显示点数，firstX 为其中第一个点的X
+int SeriesRollup::evict(int lastX, int &firstX)
+{
+    if (buckets.isEmpty())
+        return 0;
+    const int t = buckets.size() - 1;
+    const RollupTier& tier = policy.tiers.at(t);
+    QList<RollupBucket>& list = buckets[t]; // 非 const 访问，先与快照分离，之后的移除不会再换一份数据
+    int count = 0;
+    while (!list.isEmpty() && qint64(list.first().x) + tier.bucket <= qint64(lastX) - tier.horizon)
+    {
+        const RollupBucket& bucket = list.first();
+        if (!count)
+            firstX = qMin(bucket.minX, bucket.maxX);
+        count += bucket.pointCount();
+        removeFirstBucket(t);
+    }
+    return count;
+}
+
+/// 移除最早的一个桶，返回移除的显示点数
+int SeriesRollup::removeFirst(int &firstX)
+{
+    for (int t = buckets.size() - 1; t >= 0; t--)
+    {
+        QList<RollupBucket>& list = buckets[t];
+        if (list.isEmpty())
+            continue;
+        const int count = list.first().pointCount();
+        firstX = qMin(list.first().minX, list.first().maxX);
+        removeFirstBucket(t);
+        return count;
+    }
+    return 0;
+}
+
+void SeriesRollup::clear()
+{
+    for (int t = 0; t < buckets.size(); t++)
+    {
+        buckets[t].clear();
+        rebuildIndex(t);
+    }
+    points = 0;
+}
+
+bool SeriesRollup::isEmpty() const
+{
+    return !points;
+}
+
+int SeriesRollup::pointCount() const
+{
+    return points;
+}
+
+/// 最后一个显示的点的X
+int SeriesRollup::lastX() const
+{
+    Q_ASSERT(points);
+    for (const QList<RollupBucket>& list: buckets)
+        if (!list.isEmpty())
+            return qMax(list.last().minX, list.last().maxX);
+    return 0;
+}
+
+/// 第k个（从0开始）显示的点的X
+bool SeriesRollup::headX(int k, int &x) const
+{
+    for (int t = buckets.size() - 1; t >= 0; t--)
+    {
+        for (const RollupBucket& bucket: buckets.at(t))
+        {
+            const int count = bucket.pointCount();
+            if (k < count)
+            {
+                x = k ? qMax(bucket.minX, bucket.maxX) : qMin(bucket.minX, bucket.maxX);
+                return true;
+            }
+            k -= count;
+        }
+    }
+    return false;
+}
+
+/// 取出X在 [xFrom, xTo] 内的显示的点，以及两侧各 extra 个点（若有），追加到 out
+void SeriesRollup::collect(int xFrom, int xTo, int extra, QList<QPoint> &out) const
+{
+    QList<QPoint> range;
+    for (int t = buckets.size() - 1; t >= 0; t--)
+    {
+        const QList<RollupBucket>& list = buckets.at(t);
+        const int b0 = qMax(firstBucketAfter(t, xFrom) - extra, 0);
+        const int b1 = qMin(lastBucketBefore(t, xTo) + 1 + extra, list.size());
+        for (int i = b0; i < b1; i++)
+            appendPoints(list.at(i), range);
+    }
+    int l = qMax(lowerBoundX(range, xFrom) - extra, 0);
+    int r = qMin(upperBoundX(range, xTo) + extra, range.size());
+    for (int i = l; i < r; i++)
+        out.append(range.at(i));
+}
+
+/// X在 [xFrom, xTo] 内的统计；每级用索引查询相交的桶，只部分相交的桶以整个桶近似
+/// 桶按X先后排列，只有两端的桶可能部分相交
+RangeStatistics SeriesRollup::statistics(int xFrom, int xTo) const
+{
+    RangeStatistics stat;
+    for (int t = buckets.size() - 1; t >= 0; t--)
+    {
+        const QList<RollupBucket>& list = buckets.at(t);
+        const int l = firstBucketAfter(t, xFrom), r = lastBucketBefore(t, xTo);
+        if (l > r)
+            continue;
+        const RollupBucket& first = list.at(l);
+        const RollupBucket& last = list.at(r);
+        RangeStatistics part = indexes.at(t).statistics(l, r);
+        part.exact = first.x >= xFrom && qint64(last.x) + policy.tiers.at(t).bucket - 1 <= xTo && qMax(last.minX, last.maxX) <= xTo;
+        stat.merge(part);
+    }
+    return stat;
+}
+
+/// 第 tier 级的桶，按X递增
+const QList<RollupBucket> &SeriesRollup::getBuckets(int tier) const
+{
+    return buckets.at(tier);
+}
+
+qint64 SeriesRollup::memoryBytes() const
+{
+    qint64 bytes = 0;
+    for (const QList<RollupBucket>& list: buckets)
+        bytes += qint64(sizeof(QList<RollupBucket>)) + list.size() * qint64(sizeof(RollupBucket));
+    for (const SummaryIndex& index: indexes)
+        bytes += index.memoryBytes();
+    return bytes;
+}
+
+void SeriesRollup::save(QDataStream &out) const
+{
+    out << policy.rawHorizon << quint32(policy.tiers.size());
+    for (int t = 0; t < policy.tiers.size(); t++)
+    {
+        out << policy.tiers.at(t).bucket << policy.tiers.at(t).horizon << quint32(buckets.at(t).size());
+        for (const RollupBucket& b: buckets.at(t))
+            out << b.x << b.minX << b.minY << b.maxX << b.maxY << b.sum << b.count;
+    }
+}
+
+bool SeriesRollup::load(QDataStream &in)
+{
+    policy = RetentionPolicy();
+    buckets.clear();
+    indexes.clear();
+    points = 0;
+    quint32 tierCount = 0;
+    in >> policy.rawHorizon >> tierCount;
+    for (quint32 t = 0; t < tierCount && in.status() == QDataStream::Ok; t++)
+    {
+        RollupTier tier;
+        quint32 count = 0;
+        in >> tier.bucket >> tier.horizon >> count;
+        if (tier.bucket < 1)
+            in.setStatus(QDataStream::ReadCorruptData);
+        QList<RollupBucket> list;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+        {
+            RollupBucket b;
+            in >> b.x >> b.minX >> b.minY >> b.maxX >> b.maxY >> b.sum >> b.count;
+            list.append(b);
+            points += b.pointCount();
+        }
+        policy.tiers.append(tier);
+        buckets.append(list);
+        indexes.append(SummaryIndex());
+        rebuildIndex(buckets.size() - 1);
+    }
+    if (in.status() != QDataStream::Ok || policy.rawHorizon < 0)
+    {
+        policy = RetentionPolicy();
+        buckets.clear();
+        indexes.clear();
+        points = 0;
+        return false;
+    }
+    return true;
+}
+
+/// 向下取整对齐到宽度的整数倍（负数也向下）
+int SeriesRollup::bucketStart(int x, int width)
+{
+    const qint64 q = x >= 0 ? x / width : -((-qint64(x) + width - 1) / width);
+    return int(q * width);
+}
+
+/// 桶显示的点：最小值与最大值，按X先后
+void SeriesRollup::appendPoints(const RollupBucket &bucket, QList<QPoint> &out)
+{
+    const QPoint low(bucket.minX, bucket.minY), high(bucket.maxX, bucket.maxY);
+    if (bucket.pointCount() == 1)
+        out.append(low);
+    else if (bucket.minX <= bucket.maxX)
+        out << low << high;
+    else
+        out << high << low;
+}
+
+/// 放入第 tier 级：与最后一个桶对齐后相同则合并，否则作为新的桶
+void SeriesRollup::appendBucket(int tier, const RollupBucket &bucket)
+{
+    QList<RollupBucket>& list = buckets[tier];
+    RollupBucket b = bucket;
+    b.x = bucketStart(bucket.x, policy.tiers.at(tier).bucket);
+    if (list.isEmpty() || list.last().x < b.x)
+    {
+        list.append(b);
+        indexAppend(tier, b);
+        points += b.pointCount();
+        return ;
+    }
+
+    // 合并到最后一个桶：索引去掉最后一个后重新添加
+    RollupBucket& last = list.last();
+    SummaryIndex& index = indexes[tier];
+    index.truncate(index.size() - 1);
+    points -= last.pointCount();
+    if (b.minY < last.minY) // 相同时保留较早的
+    {
+        last.minX = b.minX;
+        last.minY = b.minY;
+    }
+    if (b.maxY > last.maxY)
+    {
+        last.maxX = b.maxX;
+        last.maxY = b.maxY;
+    }
+    last.sum += b.sum;
+    last.count += b.count;
+    indexAppend(tier, last);
+    points += last.pointCount();
+}
+
+/// 移除第 tier 级最早的一个桶
+void SeriesRollup::removeFirstBucket(int tier)
+{
+    points -= buckets.at(tier).first().pointCount();
+    buckets[tier].removeFirst();
+    indexes[tier].removeFirst();
+}
+
+/// 第一个最后的点不小于 x 的桶（按桶中真实的点，桶宽度不是上一级的整数倍时点可能超出对齐的范围）
+int SeriesRollup::firstBucketAfter(int tier, int x) const
+{
+    const QList<RollupBucket>& list = buckets.at(tier);
+    return int(std::lower_bound(list.begin(), list.end(), x, [=](const RollupBucket& b, int v) {
+        return qMax(b.minX, b.maxX) < v;
+    }) - list.begin());
+}
+
+/// 最后一个第一个点不大于 x 的桶，没有时为-1
+int SeriesRollup::lastBucketBefore(int tier, int x) const
+{
+    const QList<RollupBucket>& list = buckets.at(tier);
+    return int(std::upper_bound(list.begin(), list.end(), x, [=](int v, const RollupBucket& b) {
+        return v < qMin(b.minX, b.maxX);
+    }) - list.begin()) - 1;
+}
+
+void SeriesRollup::indexAppend(int tier, const RollupBucket &bucket)
+{
+    indexes[tier].append(bucket.minY, bucket.maxY, bucket.sum, bucket.count);
+}
+
+/// 根据第 tier 级现有的桶重建索引
+void SeriesRollup::rebuildIndex(int tier)
+{
+    indexes[tier].clear();
+    for (const RollupBucket& bucket: buckets.at(tier))
+        indexAppend(tier, bucket);
+}
@@ -0,0 +1,97 @@
+#ifndef SERIESROLLUP_H
+#define SERIESROLLUP_H
+
+#include <QList>
+#include <QPoint>
+#include <QVector>
+#include <QDataStream>
+#include "rangeindex.h"
+
+/// 一级汇总：每 bucket 宽度的X汇总为一个桶
+struct RollupTier
+{
+    int bucket = 60;                        // 桶的X宽度
+    int horizon = 0;                        // 保留的X跨度（从最新的点算起），超出后汇总到下一级，最后一级直接移除
+};
+
+/// 折线的保留策略：最近 rawHorizon 内保留原始点，更早的逐级汇总为最小/最大/平均值
+struct RetentionPolicy
+{
+    int rawHorizon = 0;                     // 原始点保留的X跨度，0为不启用
+    QList<RollupTier> tiers;                // 由细到粗；为空时超出的原始点直接移除
+
+    bool isEnabled() const
+    {
+        return rawHorizon > 0;
+    }
+};
+
+/// 一个汇总桶，显示为其中的最小值与最大值两个点（按X先后）
+struct RollupBucket
+{
+    int x = 0;                              // 桶的起点（按宽度对齐）
+    int minX = 0, minY = 0;                 // 最小值及其所在的X
+    int maxX = 0, maxY = 0;
+    qint64 sum = 0;
+    int count = 0;                          // 汇总的原始点数量
+
+    double mean() const
+    {
+        return count ? double(sum) / count : 0;
+    }
+
+    /// 显示为几个点：最小值与最大值是同一个点时只显示一个
+    int pointCount() const
+    {
+        return minX == maxX && minY == maxY ? 1 : 2;
+    }
+};
+
+/**
+ * 折线的分级汇总：超出原始点保留跨度的点汇总到第一级，每级超出跨度后再汇总到下一级
+ * 桶的X都早于原始点（压缩历史与未压缩的点），与之前后相接
+ * 显示时每个桶取最小值与最大值所在的真实的点，缩放与平移时与原始点连成一条线
+ */
+class SeriesRollup
+{
+public:
+    void setPolicy(const RetentionPolicy& policy);
+    const RetentionPolicy& getPolicy() const;
+    bool isEnabled() const;
+    int rawCutoff(int lastX) const;
+    void add(const QList<QPoint>& points);
+    bool cascade(int lastX, int& xFrom, int& xTo);
+    int evict(int lastX, int& firstX);
+    int removeFirst(int& firstX);
+    void clear();
+
+    bool isEmpty() const;
+    int pointCount() const;
+    int lastX() const;
+    bool headX(int k, int& x) const;
+    void collect(int xFrom, int xTo, int extra, QList<QPoint>& out) const;
+    RangeStatistics statistics(int xFrom, int xTo) const;
+    const QList<RollupBucket>& getBuckets(int tier) const;
+    qint64 memoryBytes() const;
+
+    void save(QDataStream& out) const;
+    bool load(QDataStream& in);
+
+private:
+    static int bucketStart(int x, int width);
+    static void appendPoints(const RollupBucket& bucket, QList<QPoint>& out);
+    void appendBucket(int tier, const RollupBucket& bucket);
+    void removeFirstBucket(int tier);
+    int firstBucketAfter(int tier, int x) const;
+    int lastBucketBefore(int tier, int x) const;
+    void indexAppend(int tier, const RollupBucket& bucket);
+    void rebuildIndex(int tier);
+
+private:
+    RetentionPolicy policy;
+    QList<QList<RollupBucket>> buckets;     // 与 policy.tiers 一一对应，每级按X递增；级别越高越早
+    QList<SummaryIndex> indexes;            // 每级桶的区间统计索引，与 buckets 一一对应
+    int points = 0;                         // 显示的点的数量
+};
+
+#endif // SERIESROLLUP_H
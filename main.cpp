@@ -1,11 +1,80 @@
 #include "mainwindow.h"
+#include "chartrecorder.h"
+#include "chartsoak.h"
 
 #include <QApplication>
+#include <QDebug>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    const QStringList args = a.arguments();
+
+    // 记录各阶段耗时与每个点的显示延迟，结束时导出为 Chrome trace 并输出延迟分布
+    ChartTrace trace;
+    int traceIndex = args.indexOf("--trace");
+    const QString tracePath = traceIndex >= 0 && traceIndex + 1 < args.size() ? args.at(traceIndex + 1) : QString();
+    auto exportTrace = [&]{
+        if (tracePath.isEmpty())
+            return ;
+        if (!trace.exportChromeJson(tracePath))
+            qWarning() << "无法写入追踪文件：" << tracePath;
+        printf("latency: %s\n", qPrintable(trace.getLatency().toString()));
+    };
+
+    // 长时间持续添加与移除数据，检查内存、对象、动画、标签与绘制耗时是否持续增长
+    // --soak <秒> [--rate <每秒点数>] [--lines <折线数>]，无界面环境加上 -platform offscreen
+    int soakIndex = args.indexOf("--soak");
+    if (soakIndex >= 0 && soakIndex + 1 < args.size())
+    {
+        auto option = [&](const QString& name, int value) {
+            int index = args.indexOf(name);
+            return index >= 0 && index + 1 < args.size() ? args.at(index + 1).toInt() : value;
+        };
+        SoakOptions options;
+        options.duration = args.at(soakIndex + 1).toInt();
+        options.rate = option("--rate", options.rate);
+        options.lines = option("--lines", options.lines);
+        LineChart chart;
+        chart.resize(800, 400);
+        chart.show();
+        if (!tracePath.isEmpty())
+            chart.setTrace(&trace);
+        ChartSoak soak(&chart, options);
+        bool ok = soak.run();
+        printf("%s\n", qPrintable(soak.toString()));
+        exportTrace();
+        return ok ? 0 : 1;
+    }
+
+    // 回放记录的交互并输出每帧绘制耗时，无界面环境加上 -platform offscreen
+    int replayIndex = args.indexOf("--replay");
+    if (replayIndex >= 0 && replayIndex + 1 < args.size())
+    {
+        LineChart chart;
+        if (!tracePath.isEmpty())
+            chart.setTrace(&trace);
+        ChartReplayer replayer(&chart);
+        if (!replayer.replay(args.at(replayIndex + 1)))
+            return 1;
+        printf("%s\n", qPrintable(replayer.getReport().toString()));
+        exportTrace();
+        return 0;
+    }
+
     MainWindow w;
     w.show();
-    return a.exec();
+
+    LineChart* chart = w.findChild<LineChart*>();
+    if (chart && !tracePath.isEmpty())
+        chart->setTrace(&trace);
+
+    // 把示例中折线图收到的交互与数据记录到文件
+    ChartRecorder recorder(chart);
+    int recordIndex = args.indexOf("--record");
+    if (recordIndex >= 0 && recordIndex + 1 < args.size())
+        recorder.start(args.at(recordIndex + 1));
+    int ret = a.exec();
+    exportTrace();
+    return ret;
 }